@@ -2,7 +2,9 @@
 
 #include "Args.hpp"
 #include "audioviz.hpp"
+#include "media/MediaFactory.hpp"
 #include "tt/FrequencyAnalyzer.hpp"
+#include "tt/Telemetry.hpp"
 #include "viz/StereoSpectrum.hpp"
 
 #ifdef AUDIOVIZ_LUA
@@ -10,6 +12,8 @@
 #endif
 
 #include <cstdlib>
+#include <filesystem>
+#include <list>
 #include <string>
 
 class Main
@@ -26,10 +30,21 @@ class Main
 	bool no_vsync = false, enc_window = false;
 
 	const Args args;
+
+	// the media urls, with .m3u playlists expanded; more than one are played as a `PlaylistMedia`.
+	// when encoding, tracks that can't be played are left out
+	const std::vector<std::string> playlist;
 	FA fa{3000};
+	std::optional<FA> ps_fa;
 	SS ss;
 	PS ps{50};
 
+	// spectra of the stems given with --stem; a list, since audioviz keeps references to them
+	std::list<SS> stem_ss;
+
+	// see --telemetry
+	std::optional<tt::Telemetry> telemetry;
+
 	Main(const Main &) = delete;
 	Main &operator=(const Main &) = delete;
 	Main(Main &&) = delete;
@@ -45,15 +60,52 @@ class Main
 	class FfmpegEncoder
 	{
 		FILE *process;
+		std::string command;
+
+		// ffconcat list of a playlist's tracks, removed once ffmpeg is done with it
+		std::filesystem::path concat_list;
 
 	public:
-		FfmpegEncoder(audioviz &, const std::string &outfile, const std::string &vcodec, const std::string &acodec);
+		/**
+		 * @param audio_urls the media the audio is taken from; a playlist's tracks are concatenated,
+		 * by the concat demuxer if the audio is copied and every track has the same codec, sample rate and
+		 * channels, otherwise by the concat filter (re-encoding copied audio with the output's default encoder)
+		 */
+		FfmpegEncoder(
+			audioviz &,
+			const std::vector<std::string> &audio_urls,
+			const std::string &outfile,
+			const std::string &vcodec,
+			const std::string &acodec);
 		~FfmpegEncoder();
+		inline const std::string &get_command() const { return command; }
 		void send_frame(const sf::Texture &);
 		void send_frame(const sf::Image &);
 	};
 
+	MediaBackend media_backend() const;
+	FfmpegCliMedia::PcmFormat pcm_format() const;
+
+	// the `--downmix` matrix for audio with `nb_channels` channels, if any
+	std::optional<DownmixMatrix> downmix(int nb_channels) const;
+
+	// the main media: the only track of `playlist`, or a `PlaylistMedia` of all of them
+	std::unique_ptr<Media> open_media(sf::Vector2u size) const;
+
+	/**
+	 * One track, raw or through the chosen backend, downmixed and wrapped in a `PrefetchMedia` as requested.
+	 * Resampled to `sample_rate` and mixed to `nb_channels` unless they are 0, see `PlaylistMedia::Opener`.
+	 */
+	std::unique_ptr<Media> open_track(const std::string &url, sf::Vector2u size, int sample_rate = 0, int nb_channels = 0) const;
 	void use_args(audioviz &);
+	void use_analyzer_args();
+	void use_spectrum_args(SS &, float hue_offset = 0);
+
+	void analyze_only(const std::string &outfile);
+
+	// `viz.prepare_frame()`, reporting the frame to `telemetry`
+	bool prepare_frame(audioviz &viz);
+	void report_encode(const std::string &outfile, const FfmpegEncoder &);
 
 	void start_in_window(audioviz &);
 	void encode(
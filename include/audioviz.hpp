@@ -1,8 +1,11 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <atomic>
 #include <optional>
+#include <semaphore>
 #include <string>
+#include <thread>
 
 #ifdef AUDIOVIZ_PORTAUDIO
 #include <portaudio.hpp>
@@ -16,6 +19,11 @@
 #include "viz/ScopeDrawable.hpp"
 
 #include "media/Media.hpp"
+#include "media/MediaFactory.hpp"
+#include "media/SeekIndex.hpp"
+#include "tt/AnalysisGraph.hpp"
+#include "tt/VideoFramePool.hpp"
+#include "tt/YuvConverter.hpp"
 
 class audioviz : public sf::Drawable
 {
@@ -27,28 +35,86 @@ private:
 	using BarType = viz::VerticalBar;
 	using ParticleShapeType = sf::CircleShape;
 
-	int fft_size{3000};
+	/**
+	 * A separate audio file (e.g. the drums of a remix) driving its own spectrum, and optionally particles,
+	 * in step with the main media. Each stem decodes and analyzes on its own worker thread, so adding stems
+	 * doesn't add to the frame time as long as there are cores left.
+	 */
+	class Stem
+	{
+	public:
+		viz::StereoSpectrum<BarType> &ss;
+		viz::ParticleSystem<ParticleShapeType> *const ps;
+		tt::StereoAnalyzer sa;
+
+	private:
+		std::unique_ptr<Media> media;
+		tt::AnalysisGraph analysis;
+
+		// audio frames per video frame of this stem's audio
+		int afpvf;
+		bool started{}, pending{};
+		std::exception_ptr error;
+
+		std::binary_semaphore work_ready{0}, work_done{0};
+
+		// declared last, so it is joined before anything it uses is destroyed
+		std::jthread worker;
+
+	public:
+		Stem(
+			const std::string &url,
+			tt::FrequencyAnalyzer &fa,
+			viz::StereoSpectrum<BarType> &ss,
+			viz::ParticleSystem<ParticleShapeType> *ps,
+			int framerate);
+		~Stem();
+
+		void set_framerate(int framerate);
+
+		// continue from `seconds` into the stem, see `audioviz::seek`
+		void seek(double seconds);
+
+		// hand the next frame's work to the worker thread
+		void begin_frame();
+
+		// wait for the work started by `begin_frame`; does nothing if already waited for
+		void finish_frame();
+
+	private:
+		void work();
+	};
+
 	int framerate{60};
+	int antialiasing;
 
 	// used for updating the particle system at 60Hz rate when framerate > 60
-	int frame_count{}, vfcount{1};
+	int frame_count{};
 
 	std::unique_ptr<Media> media;
 
 	// audio frames per video frame
-	int afpvf{media->astream().sample_rate() / framerate};
+	int afpvf{media->sample_rate() / framerate};
 
 	// fft processor
 	tt::FrequencyAnalyzer &fa;
 	tt::StereoAnalyzer sa;
 
+	// runs every analyzer configuration on the same audio; see `set_particle_analyzer`
+	tt::AnalysisGraph analysis;
+
+	// separate analysis for the particle system, if set
+	std::optional<tt::StereoAnalyzer> ps_sa;
+
+	// see `set_spectrum_smoother`; kept for stems added later
+	std::optional<tt::SpectrumSmoother> spectrum_smoother;
+
 	// stereo spectrum
 	viz::StereoSpectrum<BarType> &ss;
 	std::optional<sf::BlendMode> spectrum_bm;
 
 	// scope
 	viz::ScopeDrawable<sf::RectangleShape> scope;
-	std::vector<float> left_channel; // NEEDS to be updated when the scope is updated
 
 	// particle system
 	viz::ParticleSystem<ParticleShapeType> &ps;
@@ -63,6 +129,9 @@ private:
 	std::ostringstream tt_ss;
 	bool tt_enabled{};
 
+	// what the timing text shows, see `get_stage_times`; labels are literals or layer names
+	std::vector<std::pair<std::string_view, float>> stage_times;
+
 #ifdef AUDIOVIZ_PORTAUDIO
 	// PortAudio stuff for live playback
 	std::optional<pa::PortAudio> pa_init;
@@ -72,7 +141,44 @@ private:
 	std::vector<viz::Layer> layers;
 	tt::RenderTexture final_rt;
 
-	sf::Texture video_bg;
+	// see `add_stem`; the stems are destroyed before the members above
+	std::vector<std::unique_ptr<Stem>> stems;
+	int spectrum_margin{};
+
+	// only created if the media has a video stream; `yuv` only if its frames need converting
+	std::optional<tt::VideoFramePool> video_frames;
+	std::optional<tt::YuvConverter> yuv;
+
+	// video is scheduled against the audio clock: the audio frames consumed so far
+	int64_t audio_frames_played{};
+
+	// presentation time of the frame pushed last, which `video_frames` shows once it is due
+	double next_video_time{};
+	bool video_eof{};
+
+	// output frames that kept showing the previous video frame, and video frames read but never shown
+	int video_dups{}, video_drops{};
+	std::vector<uint8_t> dropped_frame;
+
+	// a playlist's track at the start of the audio window, see `change_track`
+	size_t track{};
+
+	// whether the background and album cover are the track's attached pic, rather than set by the user
+	bool bg_follows_media{true}, cover_follows_media{true};
+
+	// crossfade to a playlist's next track: the previous track's background and metadata are kept as snapshots,
+	// which fade out by `fade` (1 to 0) over `fade_frames` output frames while the new ones fade in
+	std::optional<tt::RenderTexture> bg_fade_rt, metadata_fade_rt, metadata_rt;
+	bool bg_fading{};
+	int fade_frame{}, fade_frames{};
+	float fade{};
+
+	// see `load_seek_index`; the loader sets `seek_index_ready` once `seek_index` can be used
+	std::optional<SeekIndex> seek_index;
+	std::atomic<bool> seek_index_ready{};
+
+	// declared last, so that a scan in progress is stopped before anything else is destroyed
+	std::jthread seek_index_loader;
 
 public:
 	// need to do this outside of the constructor otherwise the texture is broken?
@@ -84,6 +190,7 @@ public:
 	 * @param fa reference to your own `tt::FrequencyAnalyzer`
 	 * @param ss reference to your own `viz::StereoSpectrum<BarType>`
 	 * @param antialiasing antialiasing level to use for round shapes
+	 * @param backend media backend to open `media_url` with
 	 */
 	audioviz(
 		sf::Vector2u size,
@@ -91,13 +198,30 @@ public:
 		tt::FrequencyAnalyzer &fa,
 		viz::StereoSpectrum<BarType> &ss,
 		viz::ParticleSystem<ParticleShapeType> &ps,
+		int antialiasing = 4,
+		MediaBackend backend = MediaBackend::AUTO);
+
+	/**
+	 * Same as above, but visualizes an already opened `media`, e.g. one with non-default pipe options.
+	 * `media` must have been opened with `size` as its video size.
+	 */
+	audioviz(
+		sf::Vector2u size,
+		std::unique_ptr<Media> media,
+		tt::FrequencyAnalyzer &fa,
+		viz::StereoSpectrum<BarType> &ss,
+		viz::ParticleSystem<ParticleShapeType> &ps,
 		int antialiasing = 4);
 
 	/**
 	 * Add default effects to the `bg`, `spectrum`, and `particles` layers, if they exist.
+	 * The `bg` layer's effects for video are left out if the media already applied them, see `Media::video_filter()`.
 	 */
 	void add_default_effects();
 
+	// the effects `add_default_effects` gives the `bg` layer when the media has video
+	static std::vector<std::unique_ptr<fx::Effect>> default_video_bg_effects();
+
 	/**
 	 * Prepare a frame to be drawn with `draw()`.
 	 * This method does all the work to produce a frame.
@@ -116,11 +240,42 @@ public:
 
 	void set_timing_text_enabled(bool);
 
+	/**
+	 * Continue from `seconds` into the media, along with its stems and video background.
+	 * The next `prepare_frame` decodes from there, so output resumes on the next frame.
+	 * @throws `std::logic_error` unless the media is `Media::seekable()`
+	 */
+	void seek(double seconds);
+
+	/**
+	 * Seek `delta` seconds from `position()`, snapped to the nearest keyframe in that direction once the seek index
+	 * is loaded (see `load_seek_index`), so that the video background needs no decoding up to the target.
+	 */
+	void scrub(double delta);
+
+	// start of the current audio window, in seconds into the media
+	inline double position() const { return (double)audio_frames_played / media->sample_rate(); }
+
+	// whether `seek` and `scrub` work
+	inline bool seekable() const { return media->seekable(); }
+
+	// see `Media::duration`
+	inline std::optional<double> duration() const { return media->duration(); }
+
+	// how long each stage of the last `prepare_frame` took, in milliseconds, as shown by the timing text
+	inline const std::vector<std::pair<std::string_view, float>> &get_stage_times() const { return stage_times; }
+
+	/**
+	 * Load the media's `SeekIndex` on a background thread, building it if it isn't persisted yet.
+	 * Until it's done, `scrub` doesn't snap.
+	 */
+	void load_seek_index();
+
 	// important if you are capturing frames for video encoding!
 	int get_framerate() const { return framerate; }
 	void set_framerate(int framerate);
 
-	// set background image with optional effects: blur and color-multiply
+	// set background image with optional effects: blur and color-multiply. a playlist's tracks won't replace it
 	void set_background(const sf::Texture &texture);
 
 	// set margins around the output size for the spectrum to respect
@@ -129,6 +284,7 @@ public:
 	// set blend mode for spectrum against target
 	void set_spectrum_blendmode(const sf::BlendMode &);
 
+	// a playlist's tracks won't replace it
 	void set_album_cover(const std::string &image_path, sf::Vector2f size = {150, 150});
 
 	// you **must** call this method in order to see text metadata!
@@ -143,12 +299,60 @@ public:
 	 */
 	void set_fft_size(int fft_size);
 
+	/**
+	 * Drive the particle system with its own analyzer instead of the spectrum's.
+	 * Particles only need a coarse bass estimate, so a smaller FFT size and `spectrum_size` can be used.
+	 * The audio is still decoded and deinterleaved once for both analyzers, and if `fa` has the same
+	 * FFT size and window function as the spectrum's analyzer, the transform is shared as well.
+	 * @param fa analyzer to use for the particles; must outlive this `audioviz`
+	 * @param spectrum_size number of frequency bins to compute for the particles
+	 */
+	void set_particle_analyzer(tt::FrequencyAnalyzer &fa, int spectrum_size);
+
+	/**
+	 * Smooth the spectrum over time, e.g. to let a small FFT size look as stable as a large one.
+	 * Also applies to the spectra of stems, including ones added later.
+	 * Particles share this smoothing unless they have their own analyzer (see `set_particle_analyzer`).
+	 */
+	void set_spectrum_smoother(const tt::SpectrumSmoother &smoother);
+
+	/**
+	 * Smooth the particles' analysis over time.
+	 * @throws `std::logic_error` if `set_particle_analyzer` wasn't called before
+	 */
+	void set_particle_smoother(const tt::SpectrumSmoother &smoother);
+
+	/**
+	 * Add a stem: a separate audio file (e.g. drums, bass or vocals of the main media) that drives its own
+	 * spectrum, and optionally particles, on a new layer drawn above the others. Stems advance with the
+	 * main media's frame clock; playback and encoding still use the main media's audio.
+	 * The stem's decoding and analysis run on a worker thread of their own.
+	 * @param url url to the stem's audio
+	 * @param fa analyzer settings for the stem; can be shared with the main spectrum or other stems
+	 * @param ss spectrum for the stem; positioned like the main spectrum
+	 * @param ps optional particle system driven by the stem
+	 */
+	void add_stem(
+		const std::string &url,
+		tt::FrequencyAnalyzer &fa,
+		viz::StereoSpectrum<BarType> &ss,
+		viz::ParticleSystem<ParticleShapeType> *ps = nullptr);
+
 private:
 	void metadata_init();
 	void draw_spectrum();
 	void draw_particles();
 	void play_audio();
-	void capture_elapsed_time(const std::string &label, const sf::Clock &_clock);
+	void capture_elapsed_time(std::string_view label, const sf::Clock &_clock);
 	void layers_init(int);
 	void perform_fft();
+
+	// make the newest video frame that is due by the audio clock current, see `video_frames`
+	void advance_video();
+
+	// draw `txr` as the background, with the bg layer's effects applied once
+	void show_background(const sf::Texture &txr);
+
+	// start crossfading to the metadata and attached pic of a playlist's track `index`
+	void change_track(size_t index);
 };
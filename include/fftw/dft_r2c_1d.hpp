@@ -1,11 +1,15 @@
 #pragma once
 
 #include <fftw3.h>
+#include <mutex>
 #include <stdexcept>
 
 namespace fftw
 {
 
+// only fftw's execute functions are thread-safe; planning and plan destruction must be serialized
+inline std::mutex planner_mutex;
+
 template <typename _Tp>
 class dft_r2c_1d;
 
@@ -19,6 +23,7 @@ class dft_r2c_1d<float>
 
 	void init(const int N)
 	{
+		const std::lock_guard lock{planner_mutex};
 		this->N = N;
 		in = (float *)fftwf_malloc(sizeof(float) * N);
 		out = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * output_size());
@@ -27,6 +32,7 @@ class dft_r2c_1d<float>
 
 	void cleanup()
 	{
+		const std::lock_guard lock{planner_mutex};
 		fftwf_destroy_plan(p);
 		fftwf_free(in);
 		fftwf_free(out);
@@ -35,6 +41,8 @@ class dft_r2c_1d<float>
 public:
 	dft_r2c_1d(const int N) { init(N); }
 	~dft_r2c_1d() { cleanup(); }
+	dft_r2c_1d(const dft_r2c_1d &) = delete;
+	dft_r2c_1d &operator=(const dft_r2c_1d &) = delete;
 
 	void set_n(const int N)
 	{
@@ -63,6 +71,7 @@ class dft_r2c_1d<double>
 
 	void init(const int N)
 	{
+		const std::lock_guard lock{planner_mutex};
 		this->N = N;
 		in = (double *)fftw_malloc(sizeof(double) * N);
 		out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * output_size());
@@ -71,6 +80,7 @@ class dft_r2c_1d<double>
 
 	void cleanup()
 	{
+		const std::lock_guard lock{planner_mutex};
 		fftw_destroy_plan(p);
 		fftw_free(in);
 		fftw_free(out);
@@ -79,6 +89,8 @@ class dft_r2c_1d<double>
 public:
 	dft_r2c_1d(const int N) { init(N); }
 	~dft_r2c_1d() { cleanup(); }
+	dft_r2c_1d(const dft_r2c_1d &) = delete;
+	dft_r2c_1d &operator=(const dft_r2c_1d &) = delete;
 
 	void set_n(const int N)
 	{
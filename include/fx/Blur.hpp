@@ -21,6 +21,9 @@ public:
 
 	Blur(float hrad, float vrad, int n_passes);
 	void apply(tt::RenderTexture &rt) const override;
+
+	// ffmpeg's `gblur` with the standard deviation of all passes combined
+	std::optional<std::string> ffmpeg_filter() const override;
 };
 
 } // namespace fx
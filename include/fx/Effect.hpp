@@ -1,5 +1,10 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "tt/RenderTexture.hpp"
 
 namespace fx
@@ -12,6 +17,17 @@ public:
 
 	// Apply this effect onto a render-texture.
 	virtual void apply(tt::RenderTexture &) const = 0;
+
+	/**
+	 * An ffmpeg filter (as in `-vf`) with the same result, so that the effect can be applied to video
+	 * while it is decoded instead of on every frame we render. Empty if ffmpeg has no equivalent.
+	 */
+	virtual std::optional<std::string> ffmpeg_filter() const { return {}; }
+
+	/**
+	 * `effects` as a filter chain, in order; empty if any of them has no `ffmpeg_filter()`.
+	 */
+	static std::optional<std::string> ffmpeg_filters(const std::vector<std::unique_ptr<Effect>> &effects);
 };
 
 } // namespace fx
@@ -15,6 +15,9 @@ public:
 
 	Mult(float factor);
 	void apply(tt::RenderTexture &rt) const override;
+
+	// ffmpeg's `colorchannelmixer`, scaling color but not alpha like the shader
+	std::optional<std::string> ffmpeg_filter() const override;
 };
 
 } // namespace fx
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Fixed-capacity ring buffer of planar 32-bit floating point audio.
+ *
+ * Every channel's ring is followed by a mirror of itself, so the buffered frames of a channel are
+ * always contiguous, no matter where the ring wraps around. On Linux the mirror is a second mapping
+ * of the same memory (via `memfd_create`), so it costs nothing to keep up to date; elsewhere,
+ * writes simply go to both copies.
+ *
+ * Consuming frames only moves an index. The capacity grows if a write doesn't fit, which only happens
+ * until the buffer has seen its largest working set.
+ */
+class AudioRing
+{
+	int _num_channels;
+	int _capacity{}; // frames per channel
+
+	// start of channel `c`'s ring is at `base + c * 2 * _capacity`
+	float *base{};
+	bool double_mapped{};
+
+	// absolute frame positions; `write_pos - read_pos` frames are buffered
+	uint64_t read_pos{}, write_pos{};
+
+	// per-channel pointers to the oldest buffered frame, see `channels()`
+	std::vector<const float *> read_ptrs;
+
+public:
+	/**
+	 * @param capacity initial number of frames per channel that fit in the buffer
+	 */
+	AudioRing(int num_channels, int capacity = 1 << 14);
+	~AudioRing();
+
+	AudioRing(const AudioRing &) = delete;
+	AudioRing &operator=(const AudioRing &) = delete;
+
+	inline int num_channels() const { return _num_channels; }
+	inline int capacity() const { return _capacity; }
+
+	// number of buffered frames
+	inline int frames() const { return write_pos - read_pos; }
+
+	/**
+	 * Make sure at least `frames` frames fit in the buffer.
+	 * Rounds up to whole pages when double-mapped. Keeps the buffered frames.
+	 */
+	void reserve(int frames);
+
+	/**
+	 * Append `frames` frames of interleaved audio, deinterleaving them into the channel rings.
+	 */
+	void write(const float *interleaved, int frames);
+
+	/**
+	 * Append `frames` frames of planar audio; `planes[c]` points to channel `c`'s samples.
+	 */
+	void write(const float *const *planes, int frames);
+
+	/**
+	 * Drop the oldest `frames` frames, or all buffered frames if there are less.
+	 */
+	void consume(int frames);
+
+	void clear();
+
+	/**
+	 * Change the number of channels. Drops all buffered frames.
+	 */
+	void set_num_channels(int num_channels);
+
+	/**
+	 * @returns All buffered frames of channel `channel`, oldest first.
+	 * Valid until the next call to a non-`const` method.
+	 */
+	std::span<const float> channel(int channel) const;
+
+	/**
+	 * @returns One pointer per channel to its oldest buffered frame, with `frames()` contiguous frames behind each.
+	 * Suitable for planar APIs like `AnalysisGraph::analyze` or non-interleaved PortAudio streams.
+	 * Valid until the next call to a non-`const` method.
+	 */
+	inline const float *const *channels() const { return read_ptrs.data(); }
+
+private:
+	inline float *channel_base(const int c) const { return base + (size_t)c * 2 * _capacity; }
+	void allocate(int capacity);
+	void release();
+	void update_read_ptrs();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifdef AUDIOVIZ_PORTAUDIO
+
+#include <portaudio.hpp>
+
+#include "LiveMedia.hpp"
+
+/**
+ * Live audio from a PortAudio input device. The stream callback copies each buffer of `block_frames` frames
+ * into the queue and never waits: if the visualizer falls behind, blocks are dropped (see `overruns()`)
+ * instead of letting latency grow.
+ */
+class CaptureMedia : public LiveMedia
+{
+	struct Device
+	{
+		PaDeviceIndex index;
+		int sample_rate, nb_channels;
+		double latency;
+		std::string name;
+	};
+
+	pa::PortAudio pa_init;
+	PaStream *stream{};
+	const double _device_latency;
+
+public:
+	/**
+	 * @param device "default" or a device index, as listed by `list_devices`
+	 * @param sample_rate 0 for the device's default
+	 * @param nb_channels 0 for up to two, as many as the device has
+	 * @throws `std::runtime_error` if the device doesn't exist or can't be opened
+	 */
+	CaptureMedia(const std::string &device, int sample_rate, int nb_channels, int block_frames);
+	~CaptureMedia();
+
+	// input latency reported by the opened stream, in seconds; already part of `latency()`
+	inline double device_latency() const { return _device_latency; }
+
+	// print every input device with its index, for picking one
+	static void list_devices(std::ostream &);
+
+private:
+	CaptureMedia(const Device &, int block_frames);
+
+	static Device find_device(const std::string &device, int sample_rate, int nb_channels);
+	static int callback(
+		const void *input,
+		void *output,
+		unsigned long frames,
+		const PaStreamCallbackTimeInfo *time,
+		PaStreamCallbackFlags flags,
+		void *user_data);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Linear mix of `in_channels` source channels into `out_channels` channels:
+ * output channel `o` is the sum of input channel `i` times `coefficient(o, i)` over all `i`.
+ * Applied while audio goes into a `Media`'s audio buffer, so e.g. surround sources are analyzed
+ * and played as stereo without downmixing them beforehand.
+ */
+class DownmixMatrix
+{
+	int _in_channels, _out_channels;
+	std::vector<float> coefficients; // row-major, one row per output channel
+
+public:
+	/**
+	 * @param coefficients `out_channels` rows of `in_channels` coefficients each
+	 */
+	DownmixMatrix(int in_channels, int out_channels, std::vector<float> coefficients);
+
+	inline int in_channels() const { return _in_channels; }
+	inline int out_channels() const { return _out_channels; }
+	inline float coefficient(const int out, const int in) const { return coefficients[out * _in_channels + in]; }
+
+	/**
+	 * ITU-R BS.775 style downmix of a common layout to stereo, for sources in ffmpeg's channel order:
+	 * mono (copied to both sides), 5.1 (FL FR FC LFE SL SR) and 7.1 (FL FR FC LFE BL BR SL SR).
+	 * Center and surrounds go in at -3 dB, the LFE is dropped; each row is normalized so that the output can't clip.
+	 * @returns nothing for other channel counts, whose layout isn't known well enough to mix
+	 */
+	static std::optional<DownmixMatrix> itu_stereo(int in_channels);
+
+	/**
+	 * Parse a matrix as accepted by `--downmix`: output channels separated by ';', each being
+	 * `in_channels` comma-separated coefficients, e.g. "1,0,0.7,0,0.7,0;0,1,0.7,0,0,0.7" for 5.1 to stereo.
+	 * @throws `std::invalid_argument` if it's malformed or a row doesn't have `in_channels` coefficients
+	 */
+	static DownmixMatrix parse(const std::string &spec, int in_channels);
+
+	/**
+	 * Mix `frames` frames of interleaved input into the planar output `out`.
+	 */
+	void apply(const float *interleaved, int frames, float *const *out) const;
+
+	/**
+	 * Mix `frames` frames of planar input into the planar output `out`.
+	 */
+	void apply(const float *const *planes, int frames, float *const *out) const;
+};
@@ -1,20 +1,54 @@
 #pragma once
 
 #include "FfmpegCliMedia.hpp"
+#include "PipePump.hpp"
 #include <boost/process.hpp>
 
 namespace bp = boost::process;
 
+/**
+ * On POSIX systems a single `ffmpeg` process writes both streams: audio to an inherited pipe
+ * (`pipe:<fd>`), video to its stdout. On Windows each stream gets its own process.
+ */
 class FfmpegCliBoostMedia : public FfmpegCliMedia
 {
-	bp::child audioc, videoc;
-	bp::basic_pipe<float> audio;
-	bp::basic_pipe<uint8_t> video;
-	std::vector<uint8_t> video_buffer;
+	bp::child ffmpeg, video_ffmpeg;
+	bp::pipe audio, video;
+
+	// ffmpeg's arguments before the seek position is known: input options and input,
+	// then audio and video output options without the output itself
+	std::vector<std::string> input_args, audio_args, video_args;
+	bool with_video{};
+
+#ifndef _WIN32
+	// keep both pipes drained, so that ffmpeg isn't stuck writing one while we wait on the other.
+	// a pipe holds at most `/proc/sys/fs/pipe-max-size`, which can be less than one video frame. only used with video
+	std::optional<PipePump> audio_pump, video_pump;
+#endif
 
 public:
-	FfmpegCliBoostMedia(const std::string &url, sf::Vector2u video_size = {});
+	/**
+	 * @param max_video_fps rate video is shown at; faster video is thinned out by ffmpeg. 0 to keep every frame
+	 * @param video_filter ffmpeg filters to run on the scaled video, see `video_filter()`
+	 * @param yuv_video pipe 4:2:0 yuv instead of rgba where possible, see `video_format()`
+	 * @param sample_rate rate to resample the audio to; 0 for the audio stream's own
+	 */
+	FfmpegCliBoostMedia(
+		const Source &source,
+		sf::Vector2u video_size = {},
+		PcmFormat pcm_format = PcmFormat::F32LE,
+		int max_video_fps = 0,
+		const std::string &video_filter = {},
+		bool yuv_video = false,
+		int sample_rate = 0);
 	~FfmpegCliBoostMedia();
-	size_t read_audio_samples(float *buf, int samples) override;
-	bool read_video_frame(sf::Texture &txr) override;
+
+protected:
+	void restart(double start) override;
+	size_t read_audio_bytes(void *buf, size_t bytes) override;
+	size_t read_video_bytes(void *buf, size_t bytes) override;
+
+private:
+	// start ffmpeg on fresh pipes, reading from `start` seconds into the input
+	void spawn(double start);
 };
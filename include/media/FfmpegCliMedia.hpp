@@ -1,23 +1,126 @@
 #pragma once
 
 #include "Media.hpp"
+#include "VideoScalePath.hpp"
 
+/**
+ * Base for media backends that read raw PCM audio and raw RGBA video from ffmpeg processes through pipes.
+ * Pipe data is read straight into reusable heap buffers, never onto the stack.
+ */
 class FfmpegCliMedia : public Media
 {
 public:
-	// inherit constructor from base class!!!!!! nice feature!!!!!!!!!
-	using Media::Media;
-
-	void decode_audio(const int frames) override
+	/**
+	 * Sample format ffmpeg writes to the audio pipe.
+	 * `S16LE` halves the pipe bandwidth at the cost of converting to float on our side, and of
+	 * precision beyond 16 bits, which doesn't matter for visualization.
+	 */
+	enum class PcmFormat
 	{
-		const auto samples_to_read = frames * _astream.nb_channels();
-		while (_audio_buffer.size() < samples_to_read)
-		{
-			float buf[samples_to_read];
-			const auto samples_read = read_audio_samples(buf, samples_to_read);
-			if (!samples_read)
-				return;
-			_audio_buffer.insert(_audio_buffer.end(), buf, buf + samples_read);
-		}
-	}
+		F32LE,
+		S16LE
+	};
+
+	const PcmFormat pcm_format;
+
+private:
+	// raw bytes from the audio pipe; an incomplete frame at the end is kept for the next read
+	std::vector<std::byte> _pcm_buffer;
+	size_t _pcm_buffer_fill{};
+
+	// `S16LE` samples converted to float
+	std::vector<float> _converted;
+
+	// one rgba video frame, for uploading
+	std::vector<uint8_t> _video_buffer;
+
+	// frames read since ffmpeg started at `_start_time`; it outputs them at a constant `_video_frame_rate`,
+	// see `fps_filter()`
+	int64_t _video_frames_read{};
+	double _start_time{};
+
+public:
+	// @param sample_rate rate ffmpeg resamples the audio to; 0 for the audio stream's own
+	FfmpegCliMedia(
+		const Source &source, sf::Vector2u video_size, PcmFormat pcm_format = PcmFormat::F32LE, int sample_rate = 0);
+
+	/**
+	 * Read raw samples from the audio pipe, bypassing the audio buffer.
+	 * @throws `std::logic_error` if the pipe format isn't `F32LE`
+	 */
+	size_t read_audio_samples(float *buf, int samples) override;
+
+	/**
+	 * @throws `std::logic_error` unless frames are rgba; upload yuv frames through the span overload
+	 */
+	bool read_video_frame(sf::Texture &txr) override;
+	bool read_video_frame(std::span<uint8_t> pixels) override;
+	void decode_audio(int frames) override;
+
+	/**
+	 * Restarts ffmpeg with its input seeking to `seconds`. ffmpeg decodes from the keyframe before it and
+	 * drops everything up to it, so audio starts at exactly that sample.
+	 */
+	void seek(double seconds) override;
+	inline bool seekable() const override { return true; }
+
+protected:
+	/**
+	 * Stop the ffmpeg processes and start them again, reading from `start` seconds into the input.
+	 * Everything piped before is discarded.
+	 */
+	virtual void restart(double start) = 0;
+
+	// input options that make ffmpeg start at `start` seconds; none for 0
+	static std::vector<std::string> start_args(double start);
+
+	// ffmpeg name of `pcm_format`, for both `-f` and `-c:a pcm_<name>`
+	const char *pcm_format_name() const;
+
+	// bytes per sample of `pcm_format`
+	size_t pcm_sample_size() const;
+
+	/**
+	 * Read up to `bytes` bytes from the audio/video pipe into `buf`.
+	 * @returns The number of bytes read, or 0 at the end of the stream
+	 */
+	virtual size_t read_audio_bytes(void *buf, size_t bytes) = 0;
+	virtual size_t read_video_bytes(void *buf, size_t bytes) = 0;
+
+	/**
+	 * Ask the kernel for a pipe buffer of up to `bytes` bytes (Linux only), so that ffmpeg can run
+	 * further ahead of us and every read moves more data. Failing to do so isn't an error.
+	 */
+	static void enlarge_pipe(int fd, int bytes);
+
+	/**
+	 * An `fps` filter for `_video_frame_rate`. With it ffmpeg drops frames that would never be shown before they are
+	 * scaled and piped, and duplicates or drops frames of variable frame rate video, so that frame `n` is
+	 * presented at `n / _video_frame_rate`.
+	 */
+	std::string fps_filter() const;
+
+	/**
+	 * Set `_video_format` for frames scaled through `path`: rgba, unless `yuv` asks for 4:2:0, which is only possible
+	 * if `video_size` packs into whole texels (see `VideoFormat`). Then it's whatever `path` ends up with anyway:
+	 * nv12 after vaapi scaling, unless filters run after it, and yuv420p otherwise.
+	 */
+	void choose_video_format(bool yuv, const VideoScalePath &path);
+
+	// ffmpeg's name for `_video_format`, for `-pix_fmt`
+	const char *pix_fmt_name() const;
+
+	/**
+	 * Input options that let ffmpeg skip most of its own probing, since `_reader` already did it:
+	 * the demuxer it found, and a probe size of about what it had to read.
+	 * Frame rates aren't estimated either, since `fps_filter()` sets the output rate anyway.
+	 */
+	std::vector<std::string> probe_hint_args() const;
+
+	// `-ar` output option if the audio is resampled, see the constructor; none otherwise
+	std::vector<std::string> resample_args() const;
+
+	// `-map` output options for exactly the streams we probed, so that ffmpeg can't pick others
+	std::string audio_map() const;
+	std::string video_map() const;
 };
@@ -1,15 +1,57 @@
 #pragma once
 
 #include "FfmpegCliMedia.hpp"
+#include "PipePump.hpp"
 
+/**
+ * On POSIX systems a single `ffmpeg` process writes both streams: audio to an inherited pipe
+ * (`pipe:<fd>`), video to its stdout. On Windows each stream gets its own process.
+ */
 class FfmpegCliPopenMedia : public FfmpegCliMedia
 {
 private:
 	FILE *audio{nullptr}, *video{nullptr};
 
+	// ffmpeg's command line before the seek position is known: the command and input options,
+	// then audio and video output options without the output itself, each ending in a space
+	std::string input_args, audio_args, video_args;
+	bool with_video{};
+
+#ifndef _WIN32
+	// read end of the audio pipe when one process writes both streams
+	int audio_fd{-1};
+
+	// keep both pipes drained, so that ffmpeg isn't stuck writing one while we wait on the other.
+	// a pipe holds at most `/proc/sys/fs/pipe-max-size`, which can be less than one video frame. only used with video
+	std::optional<PipePump> audio_pump, video_pump;
+#endif
+
 public:
-	FfmpegCliPopenMedia(const std::string &url, sf::Vector2u video_size = {});
+	/**
+	 * @param max_video_fps rate video is shown at; faster video is thinned out by ffmpeg. 0 to keep every frame
+	 * @param video_filter ffmpeg filters to run on the scaled video, see `video_filter()`
+	 * @param yuv_video pipe 4:2:0 yuv instead of rgba where possible, see `video_format()`
+	 * @param sample_rate rate to resample the audio to; 0 for the audio stream's own
+	 */
+	FfmpegCliPopenMedia(
+		const Source &source,
+		sf::Vector2u video_size = {},
+		PcmFormat pcm_format = PcmFormat::F32LE,
+		int max_video_fps = 0,
+		const std::string &video_filter = {},
+		bool yuv_video = false,
+		int sample_rate = 0);
 	~FfmpegCliPopenMedia();
-	size_t read_audio_samples(float *buf, int samples) override;
-	bool read_video_frame(sf::Texture &txr) override;
+
+protected:
+	void restart(double start) override;
+	size_t read_audio_bytes(void *buf, size_t bytes) override;
+	size_t read_video_bytes(void *buf, size_t bytes) override;
+
+private:
+	// start ffmpeg, reading from `start` seconds into the input
+	void spawn(double start);
+
+	// close the pipes, which makes ffmpeg exit on its next write, and wait for it
+	void close_pipes();
 };
@@ -1,32 +1,157 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
-#include <list>
+#include <atomic>
+#include <memory>
 #include <optional>
+#include <thread>
+
+extern "C"
+{
+#include <libswscale/swscale.h>
+}
 
 #include "Media.hpp"
 #include "av/Frame.hpp"
 #include "av/Resampler.hpp"
-#include "av/SwScaler.hpp"
+#include "tt/SpscQueue.hpp"
 
+/**
+ * Decodes with the libav* libraries in-process.
+ * A demuxer thread routes packets to one decoder thread per stream; decoded audio and scaled rgba video frames
+ * are handed to the thread calling `decode_audio`/`read_video_frame` through bounded queues.
+ * The video decoder uses frame and slice threading, and scaling is sliced across threads by swscale.
+ */
 class LibavMedia : public Media
 {
-	av::Decoder _adecoder{_astream.create_decoder()};
+	// preallocated queue elements; copying allocates a new one instead of sharing, for `tt::SpscQueue`'s initial value
+	struct PacketSlot
+	{
+		AVPacket *packet{av_packet_alloc()};
+		PacketSlot() = default;
+		PacketSlot(const PacketSlot &)
+			: PacketSlot{}
+		{
+		}
+		PacketSlot &operator=(const PacketSlot &) = delete;
+		~PacketSlot() { av_packet_free(&packet); }
+	};
+
+	struct FrameSlot
+	{
+		AVFrame *frame{av_frame_alloc()};
+		double time{}; // presentation time in seconds
+		FrameSlot(sf::Vector2u size);
+		FrameSlot(const FrameSlot &other)
+			: FrameSlot{sf::Vector2u(other.frame->width, other.frame->height)}
+		{
+		}
+		FrameSlot &operator=(const FrameSlot &) = delete;
+		~FrameSlot() { av_frame_free(&frame); }
+	};
+
+	struct AudioBlock
+	{
+		std::vector<float> samples; // planar: `frames` per channel; only ever grows
+		int frames{};
+	};
+
+	struct SwsDeleter
+	{
+		void operator()(SwsContext *c) const { sws_freeContext(c); }
+	};
+
+	av::Decoder _adecoder{_astream->create_decoder()};
 	av::Resampler _resampler{
-		// output params
-		{&_astream->codecpar->ch_layout, AV_SAMPLE_FMT_FLT, _astream.sample_rate()},
+		// output params: planar, so frames go straight into the planar audio buffer
+		{&(*_astream)->codecpar->ch_layout, AV_SAMPLE_FMT_FLTP, _sample_rate},
 		// input params
-		{&_astream->codecpar->ch_layout, (AVSampleFormat)_astream->codecpar->format, _astream.sample_rate()}};
+		{&(*_astream)->codecpar->ch_layout, (AVSampleFormat)(*_astream)->codecpar->format, _sample_rate}};
 	av::Frame rs_frame;
 
 	std::optional<av::Decoder> _vdecoder;
-	std::optional<av::SwScaler> _scaler;
-	std::optional<av::Frame> _scaled_frame;
-	std::optional<std::list<sf::Texture>> _frame_queue;
+	std::unique_ptr<SwsContext, SwsDeleter> _scaler;
+
+	// demuxer -> decoder threads
+	tt::SpscQueue<PacketSlot> _audio_packets{64};
+	std::optional<tt::SpscQueue<PacketSlot>> _video_packets;
+
+	// decoder threads -> caller
+	tt::SpscQueue<AudioBlock> _audio_blocks{16};
+	std::optional<tt::SpscQueue<FrameSlot>> _frame_queue;
+
+	// per-channel pointers into the front audio block
+	std::vector<const float *> _planes;
+
+	// video decoder thread only: frames are dropped before scaling while they come in faster than `_video_frame_rate`
+	bool _drop_frames{};
+	double _next_frame_time{};
+
+	// after a seek, decoded audio before this time is trimmed off and video frames that end before it are dropped.
+	// only written while the decoder threads are stopped
+	double _seek_time{};
+	bool _trim_audio{};
+
+	// set by the demuxer while it waits for room for a video packet, see `video_stalls_audio`
+	std::atomic<bool> _demux_waits_on_video{};
+
+	// set by each thread once it won't push anything more
+	std::atomic<bool> _demux_eof{}, _audio_eof{}, _video_eof{};
+	std::exception_ptr _demux_error, _audio_error, _video_error;
+
+	// bumped on every push and pop, so that any thread can sleep until another made progress
+	std::atomic<uint32_t> _progress{};
+
+	// declared last, so they are joined before anything they use is destroyed
+	std::jthread _demuxer, _audio_decoder, _video_decoder;
 
 public:
-	LibavMedia(const std::string &url, sf::Vector2u vsize);
+	// decoded frames kept ahead of `read_video_frame`
+	static constexpr int max_queued_frames = 4;
+
+	/**
+	 * @param vsize size to scale video to; leave empty to not decode video
+	 * @param max_video_fps rate video is shown at; frames of faster video are dropped before scaling. 0 to keep every frame
+	 */
+	LibavMedia(const Source &source, sf::Vector2u vsize, int max_video_fps = 0);
+	~LibavMedia();
+
 	inline size_t read_audio_samples(float *buf, int samples) override { return 0; }
 	bool read_video_frame(sf::Texture &txr) override;
+	bool read_video_frame(std::span<uint8_t> rgba) override;
 	void decode_audio(int audio_frames) override;
+
+	/**
+	 * Stops the threads, seeks the demuxer to the keyframe before `seconds`, and restarts them with empty queues.
+	 * Audio is trimmed to the sample by the decoded frames' timestamps.
+	 */
+	void seek(double seconds) override;
+	inline bool seekable() const override { return true; }
+
+private:
+	void signal_progress();
+	void start_threads();
+	void stop_threads();
+
+	// waits until `ready()`, re-checking whenever another thread made progress.
+	// @returns `false` if `st` was stopped first
+	template <typename Ready>
+	bool wait_until(const std::stop_token &st, Ready ready);
+
+	void demux(std::stop_token);
+	void decode_audio_packets(std::stop_token);
+	void decode_video_packets(std::stop_token);
+
+	/**
+	 * Whether the demuxer waits for room for video while the audio decoder has nothing left to decode.
+	 * Video is then read more slowly than it comes in, and waiting for that would stall audio too,
+	 * so the video decoder drops frames instead of waiting for room in `_frame_queue`.
+	 */
+	bool video_stalls_audio() const;
+
+	// whether the frame presented at `time` is worth scaling and queueing, see `_drop_frames`
+	bool keep_video_frame(double time);
+
+	// waits for the next video frame; `nullptr` at the end of the stream
+	const AVFrame *next_video_frame();
 };
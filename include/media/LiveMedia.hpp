@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+#include "Media.hpp"
+#include "tt/SpscQueue.hpp"
+
+/**
+ * Base for media that arrives in real time, e.g. from a capture device or a pipe, instead of being read from a file.
+ * A producer thread (or audio callback) hands interleaved blocks of `block_frames` frames to `decode_audio` through
+ * a small fixed queue, so at most `queue_blocks` blocks are ever waiting. Each block carries the time its first frame
+ * was captured, which is what `latency()` is measured against.
+ * Audio only; there's no probing, so `format()` and `astream()` aren't available.
+ */
+class LiveMedia : public Media
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// blocks the queue holds; beyond that, producers either wait (pipes) or drop blocks (capture devices)
+	static constexpr int queue_blocks = 8;
+
+	const int block_frames;
+
+protected:
+	struct Block
+	{
+		std::vector<float> samples; // interleaved, `block_frames` frames
+		int frames{};
+		Clock::time_point captured;
+	};
+
+	tt::SpscQueue<Block> _blocks;
+
+	// set by the producer after its last push
+	std::atomic<bool> _eof{};
+	std::exception_ptr _error;
+
+	// bumped on every push and pop, so that either side can sleep until the other made progress
+	std::atomic<uint32_t> _progress{};
+
+	// blocks the producer had to drop because the queue was full
+	std::atomic<int> _overruns{};
+
+private:
+	// consumer side: total frames written to the audio buffer, and where and when the newest block was captured
+	uint64_t _written{}, _newest_start{};
+	Clock::time_point _newest_captured;
+
+public:
+	/**
+	 * Blocks until enough audio arrived, or the input ended.
+	 */
+	void decode_audio(int frames) override;
+
+	size_t read_audio_samples(float *buf, int samples) override;
+	inline bool read_video_frame(sf::Texture &) override { return false; }
+	inline bool read_video_frame(std::span<uint8_t>) override { return false; }
+
+	/**
+	 * End-to-end latency: seconds since the oldest frame in the audio buffer was captured,
+	 * i.e. how far what's being visualized lags behind the input. 0 until audio arrived.
+	 */
+	double latency() const;
+
+	inline int overruns() const { return _overruns; }
+	inline int queued_blocks() const { return _blocks.size(); }
+
+protected:
+	LiveMedia(const std::string &url, int sample_rate, int nb_channels, int block_frames);
+
+	void signal_progress();
+};
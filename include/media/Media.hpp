@@ -2,34 +2,203 @@
 
 #include <SFML/Graphics.hpp>
 #include <av/MediaReader.hpp>
+#include <memory>
+#include <optional>
+#include <span>
+
+#include "AudioRing.hpp"
+#include "DownmixMatrix.hpp"
 
 class Media
 {
 public:
+	/**
+	 * Pixel format of the frames `read_video_frame(std::span<uint8_t>)` returns.
+	 * The 4:2:0 formats are 1.5 bytes per pixel instead of 4, with the planes back to back as ffmpeg writes them.
+	 * That layout can be uploaded as is into an rgba texture of `video_size.x / 4` by `video_size.y * 3 / 2`
+	 * texels, and converted when drawn, see `tt::YuvConverter`.
+	 */
+	enum class VideoFormat
+	{
+		RGBA,
+		YUV420P, // y plane, then the u and v planes
+		NV12 // y plane, then interleaved u and v
+	};
+
+	/**
+	 * A url to open, along with libav's probe of it if the caller already made one (see `create_media`),
+	 * so that it isn't probed again. Converts from a plain url.
+	 */
+	struct Source
+	{
+		std::string url;
+		std::shared_ptr<av::MediaReader> probe;
+
+		Source(const std::string &url, std::shared_ptr<av::MediaReader> probe = {})
+			: url{url},
+			  probe{std::move(probe)}
+		{
+		}
+
+		Source(const char *url)
+			: Source{std::string{url}}
+		{
+		}
+	};
+
 	const std::string url;
 	const sf::Vector2u video_size;
 
 protected:
-	av::MediaReader _format;
+	// libav's view of the media, shared with decorators (see the protected constructor) so it's only probed once.
+	// both are empty for media that libav doesn't open, see the unprobed constructor
+	std::shared_ptr<av::MediaReader> _reader;
+	std::optional<av::Stream> _astream;
+
+	// `_nb_channels` are the channels backends decode; the audio buffer has `nb_channels()`, which differ if downmixed
+	const int _sample_rate, _nb_channels;
+	AudioRing _audio_buffer{_nb_channels};
 
-	av::Stream _astream{_format.find_best_stream(AVMEDIA_TYPE_AUDIO)};
-	std::vector<float> _audio_buffer;
+	std::optional<DownmixMatrix> _downmix;
+	std::vector<float> _mixed;
+	std::vector<float *> _mixed_planes;
 
 	std::optional<av::Stream> _vstream;
-	std::optional<sf::Texture> _attached_pic;
+
+	// see `video_frame_rate()` and `video_frame_time()`
+	AVRational _video_frame_rate{0, 1};
+	double _video_frame_time{};
+
+	// see `video_filter()` and `video_format()`
+	std::string _video_filter;
+	VideoFormat _video_format{VideoFormat::RGBA};
+
+	// encoded attached pic, only decoded into `_attached_pic` on first use.
+	// this way headless users (e.g. --analyze-only) never create a texture, and with it an opengl context.
+	std::span<const uint8_t> _attached_pic_data;
+	mutable std::optional<sf::Texture> _attached_pic;
 
 public:
-	Media(const std::string &url, sf::Vector2u video_size);
+	/**
+	 * Probes the source with libav, unless it comes with a probe, for backends that decode with libav or ffmpeg.
+	 * @param sample_rate rate the backend resamples the audio to; 0 for the audio stream's own
+	 * @throws `av::Error` if it can't be opened or has no audio stream
+	 */
+	Media(const Source &source, sf::Vector2u video_size, int sample_rate = 0);
 	virtual ~Media() = default; // fixes clangd warning
 
 	virtual size_t read_audio_samples(float *buf, int samples) = 0;
 	virtual bool read_video_frame(sf::Texture &txr) = 0;
 	virtual void decode_audio(int frames) = 0;
+
+	/**
+	 * Read the next video frame as `video_size` pixels in `video_format()` into `pixels`, without touching opengl,
+	 * so that it can be called from any thread.
+	 * @returns `false` if there are no more frames
+	 * @throws `std::logic_error` if the backend doesn't support it
+	 */
+	virtual bool read_video_frame(std::span<uint8_t> pixels);
+
+	/**
+	 * Continue from `seconds` into the media: the audio buffer is emptied, and the next decoded sample is the one at
+	 * `seconds`. Video continues with the frame shown at that time; seeking to a keyframe (see `SeekIndex`) avoids
+	 * decoding the frames before it. Seeking past the end leaves nothing more to decode.
+	 * @throws `std::logic_error` unless `seekable()`
+	 */
+	virtual void seek(double seconds);
+
+	// whether `seek` works, e.g. not for live input
+	virtual bool seekable() const { return false; }
+
+	/**
+	 * Drop the oldest `frames` frames of the audio buffer. Only moves an index.
+	 */
 	void audio_buffer_erase(int frames);
 
-	inline const av::MediaReader &format() const { return _format; }
-	inline const av::Stream &astream() const { return _astream; }
+	inline int sample_rate() const { return _sample_rate; }
+	inline int nb_channels() const { return _audio_buffer.num_channels(); }
+
+	/**
+	 * From now on, mix the decoded channels with `matrix` before they go into the audio buffer,
+	 * or stop mixing if it's empty. Call before decoding: buffered audio is dropped.
+	 * @throws `std::invalid_argument` if the matrix doesn't take this media's channels
+	 */
+	void set_downmix(std::optional<DownmixMatrix> matrix);
+
+	// whether libav probed this media, i.e. whether `format()` and `astream()` can be used
+	inline bool probed() const { return _reader != nullptr; }
+
+	/**
+	 * @throws `std::logic_error` if the media wasn't probed
+	 */
+	const av::MediaReader &format() const;
+	const av::Stream &astream() const;
+
+	/**
+	 * A metadata tag such as "title" or "artist", from the container or else the audio stream.
+	 */
+	virtual std::optional<std::string> metadata(const std::string &key) const;
+
+	/**
+	 * Length of the audio in seconds, if known: not for live input, or formats that store no length
+	 * and can't be estimated from the bitrate.
+	 */
+	virtual std::optional<double> duration() const;
+
 	inline const std::optional<av::Stream> &vstream() const { return _vstream; }
-	inline const std::optional<sf::Texture> &attached_pic() const { return _attached_pic; }
-	inline const std::vector<float> &audio_buffer() const { return _audio_buffer; }
+
+	/**
+	 * Nominal rate of the frames `read_video_frame` returns: the video stream's average frame rate,
+	 * or less if the backend drops frames while decoding (see `max_video_fps` of `create_media`). 0 without video.
+	 */
+	inline AVRational video_frame_rate() const { return _video_frame_rate; }
+
+	/**
+	 * Presentation time of the frame `read_video_frame` returned last, in seconds from the start of the media.
+	 */
+	virtual double video_frame_time() const { return _video_frame_time; }
+
+	/**
+	 * ffmpeg filters the backend applied to the scaled video frames, e.g. effects offloaded from rendering.
+	 * Empty if none, including when they were asked for but the backend can't apply them.
+	 */
+	inline const std::string &video_filter() const { return _video_filter; }
+
+	inline VideoFormat video_format() const { return _video_format; }
+
+	// bytes of one frame in `video_format()`
+	size_t video_frame_bytes() const;
+
+	virtual const std::optional<sf::Texture> &attached_pic() const;
+
+	/**
+	 * Decoded audio that hasn't been erased yet, stored planar: use `channel(c)` or `channels()`
+	 * to get contiguous per-channel windows for analysis, the scope or playback.
+	 */
+	inline const AudioRing &audio_buffer() const { return _audio_buffer; }
+
+protected:
+	/**
+	 * Append decoded audio with `_nb_channels` channels to the audio buffer, downmixed if requested.
+	 * Backends should use these instead of writing to `_audio_buffer` directly.
+	 */
+	void write_audio(const float *interleaved, int frames);
+	void write_audio(const float *const *planes, int frames);
+
+	/**
+	 * `_vstream`'s average frame rate, or `max_fps` if that is lower and positive.
+	 * Falls back to the real base frame rate, then to 25, for streams that don't have one.
+	 */
+	AVRational capped_video_rate(int max_fps) const;
+
+	/**
+	 * For media read without libav, e.g. from a memory-mapped file or a capture device.
+	 */
+	Media(const std::string &url, sf::Vector2u video_size, int sample_rate, int nb_channels);
+
+	/**
+	 * For decorators: shares `probed`'s format context, streams and attached pic instead of probing again.
+	 * The audio buffer starts out empty, with `probed`'s (possibly downmixed) channels.
+	 */
+	Media(const Media &probed, sf::Vector2u video_size);
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "FfmpegCliMedia.hpp"
+#include "PcmCache.hpp"
+
+enum class MediaBackend
+{
+	AUTO,
+	LIBAV,
+	FFMPEG_BOOST,
+	FFMPEG_POPEN,
+	WAV
+};
+
+/**
+ * Parse a backend name as accepted by `--media-backend`: "auto", "libav", "ffmpeg-boost", "ffmpeg-popen" or "wav".
+ * @throws `std::invalid_argument` for anything else
+ */
+MediaBackend media_backend_from_string(const std::string &name);
+const char *to_string(MediaBackend);
+
+/**
+ * The backend `AUTO` resolves to for `url`, judging by its streams, codecs and where it comes from:
+ * - a local pcm wav file: `WAV`, which maps it into memory and needs neither libav nor a process
+ * - video that will be decoded: `FFMPEG_BOOST`, since it decodes both streams in one process and scales on the gpu
+ * - raw pcm audio in a local file: `LIBAV`, since decoding is a copy and a process plus pipe would only add overhead
+ * - anything else: `FFMPEG_BOOST`, which handles problematic packet durations and network hiccups best
+ */
+MediaBackend choose_media_backend(const std::string &url, bool with_video);
+
+// like the above for media that isn't pcm wav, using `format`, libav's probe of `url`, instead of probing it again
+MediaBackend choose_media_backend(const std::string &url, const av::MediaReader &format, bool with_video);
+
+/**
+ * Open `url` with `backend`.
+ * @param video_size size to scale video to; leave empty to not decode video
+ * @param pcm_format pipe sample format of the ffmpeg backends
+ * @param max_video_fps frame rate video is shown at: faster video is thinned out while decoding,
+ * before frames are scaled. 0 to keep every frame
+ * @param video_filter ffmpeg filters to run on the scaled video; only the ffmpeg backends apply them,
+ * so check `Media::video_filter()` for whether they did
+ * @param yuv_video decode video to 4:2:0 yuv instead of rgba if the backend can; check `Media::video_format()`
+ */
+std::unique_ptr<Media> create_media(
+	const std::string &url,
+	sf::Vector2u video_size = {},
+	MediaBackend backend = MediaBackend::AUTO,
+	FfmpegCliMedia::PcmFormat pcm_format = FfmpegCliMedia::PcmFormat::F32LE,
+	int max_video_fps = 0,
+	const std::string &video_filter = {},
+	bool yuv_video = false);
+
+/**
+ * Like the above, but reads the decoded audio from `cache` if it's there, and otherwise caches it while decoding.
+ * Media that isn't worth caching (see `PcmCache::key`) is opened as usual.
+ */
+std::unique_ptr<Media> create_media(
+	const std::string &url,
+	sf::Vector2u video_size,
+	MediaBackend backend,
+	FfmpegCliMedia::PcmFormat pcm_format,
+	int max_video_fps,
+	const std::string &video_filter,
+	bool yuv_video,
+	const PcmCache &cache);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Media.hpp"
+
+/**
+ * Directory of decoded audio, so that compressed media only has to be decoded once.
+ * Entries are 32-bit float WAV files named after a hash of the source file's contents plus its sample rate and
+ * channel layout, and are read back through `WavMedia`'s memory-mapped path.
+ *
+ * Safe to share between processes: entries are written to temporary files and renamed into place,
+ * and eviction (least recently used first, down to `max_bytes`) holds an exclusive lock on the directory.
+ * A process that still has an evicted entry mapped keeps reading it.
+ */
+class PcmCache
+{
+public:
+	const std::filesystem::path dir;
+	const uintmax_t max_bytes;
+
+	class Writer;
+
+	/**
+	 * @param dir created if it doesn't exist
+	 * @param max_bytes total size the cache is trimmed to after each new entry
+	 */
+	PcmCache(const std::filesystem::path &dir, uintmax_t max_bytes);
+
+	/**
+	 * The cache key of the media at `source`, or nothing if it shouldn't be cached:
+	 * it isn't a local file, it's already pcm wav (see `WavMedia`), or `with_video` and it has video to decode.
+	 * Probes the source unless it comes with a probe.
+	 */
+	static std::optional<std::string> key(const Media::Source &source, bool with_video);
+
+	/**
+	 * The entry for `key`, if there is one. Marks it as recently used.
+	 */
+	std::optional<std::filesystem::path> find(const std::string &key) const;
+
+	/**
+	 * Delete the least recently used entries until the cache fits in `max_bytes`,
+	 * as well as temporary files left behind by crashed processes.
+	 */
+	void evict() const;
+
+private:
+	std::filesystem::path entry_path(const std::string &key) const;
+};
+
+/**
+ * Writes one entry. It only shows up in the cache once `commit()` is called; until then it's a temporary
+ * file that is removed if the writer is destroyed, e.g. because decoding was cut short.
+ */
+class PcmCache::Writer
+{
+	const PcmCache cache;
+	const std::filesystem::path tmp_path, final_path;
+	const int nb_channels;
+	std::ofstream out;
+	uint64_t data_bytes{};
+	std::vector<float> interleaved;
+	bool committed{};
+
+public:
+	Writer(const PcmCache &cache, const std::string &key, int sample_rate, int nb_channels);
+	~Writer();
+
+	Writer(const Writer &) = delete;
+	Writer &operator=(const Writer &) = delete;
+
+	/**
+	 * Append `frames` frames of planar audio.
+	 * @throws `std::runtime_error` if writing fails, e.g. because the disk is full
+	 */
+	void write(const float *const *planes, int frames);
+
+	// finish the header, move the file into place and evict old entries
+	void commit();
+};
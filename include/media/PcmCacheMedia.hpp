@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include "Media.hpp"
+#include "PcmCache.hpp"
+
+/**
+ * Decorator that writes everything another `Media` decodes into a `PcmCache` entry, which is committed once
+ * the audio was decoded to the end. Video is passed through untouched.
+ */
+class PcmCacheMedia : public Media
+{
+	const std::unique_ptr<Media> inner;
+	std::optional<PcmCache::Writer> writer;
+
+public:
+	PcmCacheMedia(std::unique_ptr<Media> inner, const PcmCache &cache, const std::string &key);
+
+	size_t read_audio_samples(float *buf, int samples) override;
+	inline bool read_video_frame(sf::Texture &txr) override { return inner->read_video_frame(txr); }
+	inline bool read_video_frame(std::span<uint8_t> rgba) override { return inner->read_video_frame(rgba); }
+	inline double video_frame_time() const override { return inner->video_frame_time(); }
+	void decode_audio(int frames) override;
+
+	// the entry would have a gap, so seeking gives up on caching this media
+	void seek(double seconds) override;
+	inline bool seekable() const override { return inner->seekable(); }
+	inline std::optional<double> duration() const override { return inner->duration(); }
+};
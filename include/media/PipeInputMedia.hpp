@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <thread>
+
+#include "LiveMedia.hpp"
+
+/**
+ * Live interleaved f32le audio from a pipe or other file descriptor, e.g. stdin fed by a capture program or
+ * `ffmpeg -re ... -f f32le -`. Reads whole blocks on a background thread. If the writer is faster than real time,
+ * e.g. `cat` of a raw file, the full queue holds it back, so a file-fed pipe plays like a capture device.
+ * On Linux the pipe buffer is shrunk to about one block, so data doesn't pile up in the kernel either.
+ */
+class PipeInputMedia : public LiveMedia
+{
+	const int fd;
+
+	// declared last, so it is joined before anything it uses is destroyed
+	std::jthread reader;
+
+public:
+	/**
+	 * @param fd descriptor to read from; not closed
+	 */
+	PipeInputMedia(const std::string &url, int fd, int sample_rate, int nb_channels, int block_frames);
+	~PipeInputMedia();
+
+private:
+	void read_blocks(std::stop_token);
+
+	// fills `buf` unless the input ends first; `false` if stopped
+	bool read_fully(const std::stop_token &, std::byte *buf, size_t bytes, size_t &filled);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Drains a pipe on a background thread into a bounded in-memory buffer.
+ * Needed when one process writes to two pipes: reading one of them while the process is
+ * blocked on writing to the other (full) one would deadlock, so both are kept drained.
+ */
+class PipePump
+{
+	const int fd;
+	const size_t max_bytes;
+
+	// written to wake the pump from `poll` when stopping
+	int stop_pipe[2];
+
+	std::mutex mutex;
+	std::condition_variable_any cv;
+	std::vector<std::byte> buffer;
+	size_t begin{}; // bytes before this were already read
+	bool eof{};
+	std::exception_ptr error;
+
+	// declared last, so it is joined before anything it uses is destroyed
+	std::jthread thread;
+
+public:
+	/**
+	 * @param fd pipe to read from; not closed by the pump
+	 * @param max_bytes the pump stops reading while this much is buffered
+	 */
+	PipePump(int fd, size_t max_bytes);
+	~PipePump();
+
+	PipePump(const PipePump &) = delete;
+	PipePump &operator=(const PipePump &) = delete;
+
+	/**
+	 * Same semantics as `read(2)`: blocks until anything is buffered.
+	 * @returns The number of bytes read, or 0 at the end of the stream
+	 * @throws `std::system_error` if reading the pipe failed
+	 */
+	size_t read(void *buf, size_t bytes);
+
+private:
+	void work(std::stop_token);
+};
+
+#endif
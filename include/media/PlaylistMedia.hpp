@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Media.hpp"
+
+/**
+ * Plays a list of tracks back to back as one gapless stream of audio, so that a whole mix renders in one run.
+ * While a track plays, the next one is opened, probed and has its first audio decoded on a background thread;
+ * switching to it at the boundary is no more than copying its audio on.
+ *
+ * Every track has to decode to the first track's sample rate and channels, which the `Opener` takes care of,
+ * e.g. by resampling and downmixing. Tracks that can't be opened are skipped with a message, or fail decoding
+ * if skipping is disabled.
+ * Metadata and the attached pic are those of the track at the start of the audio buffer, see `track()`.
+ * Video isn't decoded, and a playlist can't seek.
+ */
+class PlaylistMedia : public Media
+{
+public:
+	/**
+	 * Opens a track that decodes to `sample_rate` and `nb_channels`. Both are 0 for the first track, which
+	 * decides them for the rest. Called on a background thread for every track but the first.
+	 */
+	using Opener = std::function<std::unique_ptr<Media>(const std::string &url, int sample_rate, int nb_channels)>;
+
+	const std::vector<std::string> urls;
+
+private:
+	const Opener open;
+	const int preload_frames;
+	const bool skip_failed;
+
+	// the track being decoded, and where its audio starts among the frames written to the audio buffer so far
+	std::unique_ptr<Media> current;
+	size_t current_index{};
+	int64_t current_start{};
+
+	// the track before `current`, kept until its last frame leaves the audio buffer
+	std::unique_ptr<Media> previous;
+	size_t previous_index{};
+
+	int64_t frames_written{};
+	size_t _track{};
+
+	// set by `loader` when it's done; empty if none of the tracks after `current` could be opened
+	std::unique_ptr<Media> next;
+	size_t next_index{};
+
+	// set by `loader` instead of skipping a track, unless `skip_failed`
+	std::exception_ptr load_error;
+
+	// sum of the tracks' durations, probed up front by `prober`; negative until then, or if one isn't known
+	std::atomic<double> total_duration{-1};
+
+	// declared last, so that they're joined before anything they use is destroyed
+	std::jthread loader, prober;
+
+public:
+	/**
+	 * Opens the first track right away and starts loading the second.
+	 * @param preload_frames frames of audio to decode from each track before it starts playing
+	 * @param skip_failed skip tracks after the first that can't be opened; if false, `decode_audio` throws
+	 * what opening them threw once it gets to them, so that every track in `urls` is played or none
+	 * @throws `std::invalid_argument` if `urls` is empty, or whatever `open` throws for the first track
+	 */
+	PlaylistMedia(const std::vector<std::string> &urls, const Opener &open, int preload_frames, bool skip_failed = true);
+
+	// index into `urls` of the track at the start of the audio buffer, as of the last `decode_audio`
+	inline size_t track() const { return _track; }
+
+	size_t read_audio_samples(float *buf, int samples) override;
+	inline bool read_video_frame(sf::Texture &) override { return false; }
+	inline bool read_video_frame(std::span<uint8_t>) override { return false; }
+
+	/**
+	 * Decodes from the current track, moving on to the next one where it ends. That only waits if the next
+	 * track took longer to load than the current one took to play.
+	 */
+	void decode_audio(int frames) override;
+
+	// the whole playlist's, once every track was probed
+	std::optional<double> duration() const override;
+
+	std::optional<std::string> metadata(const std::string &key) const override;
+	const std::optional<sf::Texture> &attached_pic() const override;
+
+private:
+	PlaylistMedia(
+		const std::vector<std::string> &urls,
+		const Opener &open,
+		int preload_frames,
+		bool skip_failed,
+		std::unique_ptr<Media> first);
+
+	static std::unique_ptr<Media> open_first(const std::vector<std::string> &urls, const Opener &open);
+
+	// probe every track's duration into `total_duration`
+	void probe_durations(std::stop_token st);
+
+	// start loading the first track after `index` that can be opened into `next`
+	void load_after(size_t index);
+
+	// make `next` the current track; false if there is none.
+	// @throws what opening the next track threw, unless `skip_failed`
+	bool next_track();
+
+	inline const Media &playing() const { return previous ? *previous : *current; }
+};
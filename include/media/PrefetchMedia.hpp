@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "Media.hpp"
+#include "tt/SpscQueue.hpp"
+
+/**
+ * Decorator that decodes another `Media` on a background thread, ahead of time.
+ * Audio is read in blocks and video frames into memory, each into a bounded queue; `decode_audio` and
+ * `read_video_frame` then only take from the queues. As long as the background thread keeps up,
+ * the thread using this media never waits on a pipe or decoder.
+ *
+ * The wrapped media must support `read_video_frame(std::span<uint8_t>)` if it has video.
+ */
+class PrefetchMedia : public Media
+{
+	struct AudioBlock
+	{
+		std::vector<float> samples; // planar: `block_frames` per channel
+		int frames{};
+	};
+
+	struct VideoFrame
+	{
+		std::vector<uint8_t> pixels; // in `video_format()`
+		double time{}; // see `video_frame_time()`
+	};
+
+	const std::unique_ptr<Media> inner;
+	const int block_frames;
+
+	tt::SpscQueue<AudioBlock> audio_queue;
+	tt::SpscQueue<VideoFrame> video_queue;
+
+	// per-channel pointers into the front audio block
+	std::vector<const float *> planes;
+
+	// set by the background thread after its last push
+	std::atomic<bool> audio_eof{}, video_eof{};
+	std::exception_ptr error;
+
+	// bumped on every push and pop, so that either side can sleep until the other made progress
+	std::atomic<uint32_t> progress{};
+
+	// times the queues ran dry and the caller had to wait
+	std::atomic<int> _underruns{};
+
+	// declared last, so it is joined before anything it uses is destroyed
+	std::jthread worker;
+
+public:
+	/**
+	 * @param inner media to decode in the background
+	 * @param audio_blocks number of audio blocks to decode ahead
+	 * @param block_frames audio frames per block; one video frame's worth is a good choice
+	 * @param video_frames number of video frames to decode ahead
+	 */
+	PrefetchMedia(std::unique_ptr<Media> inner, int audio_blocks, int block_frames, int video_frames);
+	~PrefetchMedia();
+
+	size_t read_audio_samples(float *buf, int samples) override;
+	bool read_video_frame(sf::Texture &txr) override;
+	bool read_video_frame(std::span<uint8_t> pixels) override;
+	void decode_audio(int frames) override;
+
+	// stops the background thread, empties the queues, seeks the wrapped media and starts over
+	void seek(double seconds) override;
+	inline bool seekable() const override { return inner->seekable(); }
+	inline std::optional<double> duration() const override { return inner->duration(); }
+
+	// queue occupancy, for monitoring how far ahead decoding is
+	inline int audio_queue_size() const { return audio_queue.size(); }
+	inline int audio_queue_capacity() const { return audio_queue.capacity(); }
+	inline int video_queue_size() const { return video_queue.size(); }
+	inline int video_queue_capacity() const { return video_queue.capacity(); }
+	inline int underruns() const { return _underruns; }
+
+private:
+	void start_worker();
+	void work(std::stop_token);
+	bool prefetch_audio();
+	bool prefetch_video();
+	void signal_progress();
+
+	// waits for progress of the other thread since `seen`, and counts an underrun
+	void wait_for_progress(uint32_t seen);
+
+	// rethrows an exception from the background thread, once it has nothing more to give
+	void rethrow_error();
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+/**
+ * Presentation times of the keyframes of one stream, in seconds from the start of the media.
+ * Seeking to one of them costs no decoding beyond the keyframe itself, so interactive scrubbing snaps to them.
+ *
+ * Taken from the demuxer's own index if it has one (e.g. mp4), which is free.
+ * Otherwise the stream's packets are scanned once without decoding, and the result is persisted in
+ * `$XDG_CACHE_HOME/audioviz/seek-index`, keyed by the file's path, size and modification time.
+ * Media that isn't a local file gets an empty index, since scanning would mean downloading it.
+ */
+class SeekIndex
+{
+	std::vector<double> _times; // sorted
+
+public:
+	// an empty index, which snaps nothing
+	SeekIndex() = default;
+
+	/**
+	 * Load or build the index of `url`'s video stream if `video` and it has one, otherwise of its audio stream.
+	 * Opens `url` on its own, so it can run on any thread while the media is being decoded.
+	 * Failing to build or persist it isn't an error: the index is just empty or rebuilt next time.
+	 * @param st abandons a scan, leaving the index empty
+	 */
+	SeekIndex(const std::string &url, bool video, const std::stop_token &st = {});
+
+	inline bool empty() const { return _times.empty(); }
+	inline const std::vector<double> &times() const { return _times; }
+
+	// the last keyframe at or before `time`, if any
+	std::optional<double> at_or_before(double time) const;
+
+	// the first keyframe at or after `time`, if any
+	std::optional<double> at_or_after(double time) const;
+};
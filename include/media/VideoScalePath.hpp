@@ -0,0 +1,41 @@
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * How ffmpeg scales video to the size we render at: on the gpu through a vaapi render node, or with swscale.
+ */
+struct VideoScalePath
+{
+	// render node for vaapi scaling; empty for swscale
+	std::string vaapi_device;
+
+	// swscale algorithm for software scaling, e.g. "bilinear" or "fast_bilinear"
+	static inline std::string software_flags{"bilinear"};
+
+	/**
+	 * ffmpeg output options that scale video to `size`; the output pixel format is left to the caller.
+	 * @param pre_filter filters to run before scaling, e.g. `fps=30`, so that frames they drop are never scaled
+	 * @param post_filter filters to run on the scaled frames, e.g. effects sized for the output
+	 */
+	std::vector<std::string>
+	args(sf::Vector2u size, const std::string &pre_filter = {}, const std::string &post_filter = {}) const;
+
+	/**
+	 * The fastest path that works on this host.
+	 * On Linux every `/dev/dri/renderD*` node is tried with vaapi, as well as swscale, each with a short
+	 * ffmpeg benchmark on generated video. The winner is cached per host in `$XDG_CACHE_HOME/audioviz`
+	 * (delete it to probe again), so only the first run pays for the benchmark.
+	 * Elsewhere this is always swscale.
+	 */
+	static const VideoScalePath &best();
+
+	/**
+	 * Every render node that passed `best()`'s probe, e.g. for vaapi encoding:
+	 * swscale may win the scaling benchmark on hosts whose render nodes work fine. Cached along with `best()`.
+	 * Always empty outside of Linux.
+	 */
+	static const std::vector<std::string> &working_vaapi_devices();
+};
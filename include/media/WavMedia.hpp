@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Media.hpp"
+
+/**
+ * Reads PCM WAV (RIFF and RF64) or headerless f32le files by memory-mapping them, without libav or ffmpeg.
+ * Opening only parses the header, and decoding is a copy out of the page cache:
+ * float samples are deinterleaved straight from the mapping, integer samples are converted to float first.
+ * Audio only; video frames are never available.
+ */
+class WavMedia : public Media
+{
+public:
+	/**
+	 * Read-only mapping of a whole file, unmapped on destruction.
+	 */
+	class MappedFile
+	{
+		const std::byte *_data{};
+		size_t _size{};
+#ifdef _WIN32
+		void *_mapping{};
+#endif
+
+	public:
+		/**
+		 * @throws `std::runtime_error` if the file can't be opened or mapped
+		 */
+		explicit MappedFile(const std::string &path);
+		~MappedFile();
+
+		MappedFile(MappedFile &&other) noexcept;
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+		MappedFile &operator=(MappedFile &&) = delete;
+
+		inline std::span<const std::byte> bytes() const { return {_data, _size}; }
+	};
+
+	enum class SampleFormat
+	{
+		S16,
+		S24,
+		S32,
+		F32
+	};
+
+	// what the header says about the samples, and where they are
+	struct Layout
+	{
+		SampleFormat format;
+		int sample_rate, nb_channels;
+		size_t data_offset;
+		size_t total_frames;
+		std::string title, artist; // from a LIST/INFO chunk, if any
+	};
+
+private:
+	const MappedFile _file;
+	Layout _layout;
+	const size_t _frame_bytes;
+
+	// frames handed out so far
+	size_t _position{};
+
+	// integer (or misaligned float) samples converted to float
+	std::vector<float> _converted;
+
+public:
+	/**
+	 * Open a WAV file.
+	 * @throws `std::runtime_error` if it isn't a WAV file with 16/24/32-bit integer or 32-bit float samples
+	 */
+	WavMedia(const std::string &path);
+
+	/**
+	 * Open a headerless file of interleaved 32-bit little-endian float samples.
+	 */
+	WavMedia(const std::string &path, int sample_rate, int nb_channels);
+
+	/**
+	 * Open a WAV file holding the decoded audio of `source`, e.g. from a `PcmCache`.
+	 * `source` is probed with libav (unless it comes with a probe) for its metadata and attached pic,
+	 * which become this media's.
+	 * @throws `std::runtime_error` if the WAV file can't be read or doesn't match the source's audio
+	 */
+	WavMedia(const std::string &path, const Source &source);
+
+	/**
+	 * Whether `path` is a local WAV file that this class can read.
+	 */
+	static bool is_supported(const std::string &path);
+
+	/**
+	 * Parse the header of a RIFF or RF64 WAV file.
+	 * @throws `std::runtime_error` if it's malformed or has an unsupported sample format
+	 */
+	static Layout parse(std::span<const std::byte> file);
+
+	inline const Layout &layout() const { return _layout; }
+
+	/**
+	 * Read interleaved samples, bypassing the audio buffer.
+	 */
+	size_t read_audio_samples(float *buf, int samples) override;
+	inline bool read_video_frame(sf::Texture &) override { return false; }
+	inline bool read_video_frame(std::span<uint8_t>) override { return false; }
+	void decode_audio(int frames) override;
+
+	// moves the read position, nothing else
+	void seek(double seconds) override;
+	inline bool seekable() const override { return true; }
+
+	std::optional<std::string> metadata(const std::string &key) const override;
+
+	// exact, from the header
+	inline std::optional<double> duration() const override { return (double)_layout.total_frames / _layout.sample_rate; }
+
+private:
+	WavMedia(const std::string &path, MappedFile &&file);
+	// `layout.total_frames` is clamped to what the file actually holds
+	WavMedia(const std::string &path, MappedFile &&file, const Layout &layout);
+
+	// interleaved samples of the next `frames` frames, as float; reads from the mapping when possible
+	const float *next_frames(size_t frames);
+};
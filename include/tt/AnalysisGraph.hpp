@@ -0,0 +1,105 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "AudioAnalyzer.hpp"
+
+namespace tt
+{
+
+/**
+ * Runs several `FrequencyAnalyzer` configurations over the same block of audio.
+ * The audio is deinterleaved once per `analyze` call, and analyzers that share an FFT size
+ * and window function also share one windowed input buffer and one transform.
+ * Each analyzer only pays for its own bin mapping and interpolation.
+ */
+class AnalysisGraph
+{
+	using FA = FrequencyAnalyzer;
+
+	struct Node
+	{
+		FA &fa;
+		AudioAnalyzer &aa;
+	};
+
+	struct Transform
+	{
+		int fft_size;
+		FA::WindowFunction wf;
+		std::vector<float> window;
+
+		// one fft per channel, so that channels can be transformed concurrently.
+		// `fftw::dft_r2c_1d` owns raw buffers, so they are kept behind pointers.
+		std::vector<std::unique_ptr<fftw::dft_r2c_1d<float>>> ffts;
+
+		// normalized amplitudes per channel, valid after `execute`
+		std::vector<std::vector<float>> amplitudes;
+
+		// number of channels needed by the analyzers using this transform in the current `analyze` call
+		int num_channels{};
+
+		Transform(int fft_size, FA::WindowFunction wf);
+		void reserve_channels(int num_channels);
+		void execute(const float *audio, int channel);
+	};
+
+	std::vector<Node> nodes;
+
+	// transforms must never be moved, since nodes point to them
+	std::list<Transform> transforms;
+
+	// transform used by each node in the current `analyze` call
+	std::vector<Transform *> node_transforms;
+
+	// deinterleaved input, `required_frames()` long per channel; only used for interleaved audio
+	std::vector<std::vector<float>> channels;
+
+public:
+	/**
+	 * Register an analyzer configuration. `aa` receives spectra computed with `fa`'s settings
+	 * on every `analyze` call. Both must outlive this graph.
+	 * `aa`'s spectrum vectors must be sized by the caller, as with `AudioAnalyzer::analyze`.
+	 */
+	void add(FA &fa, AudioAnalyzer &aa);
+
+	/**
+	 * @returns The number of audio frames `analyze` reads, which is the largest FFT size of all analyzers.
+	 */
+	int required_frames() const;
+
+	/**
+	 * Analyze `required_frames()` frames of 32-bit floating point audio for every registered analyzer.
+	 * Analyzers with fewer channels than `num_channels` read the first channels of the audio.
+	 * Like `AudioAnalyzer::analyze`, channels are processed in parallel for large analyses.
+	 * @param audio audio containing at least `required_frames()` frames
+	 * @param num_channels number of channels in `audio`
+	 * @param interleaved whether `audio` is interleaved, or planar with `required_frames()` frames per channel
+	 */
+	void analyze(const float *audio, int num_channels, bool interleaved);
+
+	/**
+	 * Same as above, but with every channel in its own buffer, e.g. `Media::audio_buffer().channels()`.
+	 * The audio is read in place; nothing is copied before the transforms.
+	 * @param channels `num_channels` pointers to at least `required_frames()` frames each
+	 */
+	void analyze(const float *const *channels, int num_channels);
+
+	/**
+	 * @returns The normalized FFT amplitudes of `channel` that `fa`'s spectrum was rendered from
+	 * during the last `analyze` call. Bin `i` corresponds to the frequency `i * sample_rate / fft_size`.
+	 * @throws `std::invalid_argument` if `fa` was not part of the last `analyze` call
+	 */
+	const std::vector<float> &get_amplitudes(const FA &fa, int channel) const;
+
+private:
+	Transform &get_transform(int fft_size, FA::WindowFunction wf);
+	int prepare(int num_channels);
+	void for_each_channel(int channels_used, const std::function<void(int)> &f);
+	void analyze_channel(const float *audio, int channel);
+};
+
+} // namespace tt
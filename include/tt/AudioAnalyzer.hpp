@@ -1,31 +1,70 @@
 #pragma once
 
 #include "FrequencyAnalyzer.hpp"
+#include "SpectrumSmoother.hpp"
 
 namespace tt
 {
 
 class AudioAnalyzer
 {
+	// writes spectra computed from shared transforms directly into `_spectrum_data_per_channel`
+	friend class AnalysisGraph;
+
 private:
 	int _num_channels;
 	std::vector<std::vector<float>> _spectrum_data_per_channel;
 
+	// one per channel if smoothing is enabled, otherwise empty
+	std::vector<SpectrumSmoother> _smoothers;
+
 public:
+	/**
+	 * Channels are analyzed in parallel on `tt::ThreadPool::shared()` once `num_channels * fft_size`
+	 * reaches this many samples. Below it, handing work to other threads costs more than it saves.
+	 */
+	static constexpr int PARALLEL_THRESHOLD = 1 << 15;
+
 	AudioAnalyzer(int num_channels);
 	void resize(int size);
 
+	/**
+	 * Zero every channel's spectrum, e.g. when there is no more audio to analyze.
+	 */
+	void clear();
+
 	/**
 	 * Analyze interleaved 32-bit floating point audio.
 	 * Remember that interleaved means the samples are arranged
 	 * such that `audio[0]` belongs to the first channel, `audio[1]`
 	 * the second, and so on until `audio[num_channels - 1]`. Then
 	 * the pattern repeats.
+	 * Large analyses (see `PARALLEL_THRESHOLD`) fan channels out over a thread pool.
 	 */
 	void analyze(tt::FrequencyAnalyzer &fa, const float *audio, bool interleaved);
 
+	/**
+	 * Smooth every channel's spectrum over time with copies of `smoother` after each analysis.
+	 * Each consumer (spectrum, particles, ...) owns its analyzer, so each can be smoothed differently.
+	 */
+	void set_smoother(const SpectrumSmoother &smoother);
+
+	/**
+	 * Stop smoothing spectra, and forget the smoothing state.
+	 */
+	void disable_smoother();
+
+	/**
+	 * Forget the smoothing state but keep smoothing, e.g. after seeking, so that peaks from before don't linger.
+	 */
+	void reset_smoother();
+
 	int get_num_channels() const;
 	const std::vector<float> &get_spectrum_data(int channel_index) const;
+
+private:
+	// applies this channel's smoother, if any; channels can be smoothed concurrently
+	void smooth(int channel);
 };
 
 } // namespace tt
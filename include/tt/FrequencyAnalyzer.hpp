@@ -11,6 +11,11 @@ namespace tt
 /**
  * Analyzes wave data to produce a frequency spectrum. Allows further processing
  * of the resulting spectrum, such as scaling and interpolation.
+ *
+ * The analyzer itself only holds configuration; FFT buffers and interpolation state live in a `Scratch`.
+ * The `const` methods taking a `Scratch` can be called from several threads at once, as long as every
+ * thread uses its own `Scratch` and nobody changes the configuration meanwhile. The other methods use
+ * a scratch owned by the analyzer.
  */
 class FrequencyAnalyzer
 {
@@ -44,6 +49,23 @@ public:
 		BLACKMAN
 	};
 
+	/**
+	 * Per-thread working memory of a `FrequencyAnalyzer`.
+	 * It is resized to the analyzer's FFT size when first used with it.
+	 */
+	struct Scratch
+	{
+		fftw::dft_r2c_1d<float> fftw;
+		std::vector<float> amplitudes;
+		tk::spline spline;
+		std::vector<double> nonzero_values, indices;
+
+		Scratch(int fft_size)
+			: fftw{fft_size}
+		{
+		}
+	};
+
 private:
 	// fft size
 	int fft_size;
@@ -52,10 +74,7 @@ private:
 	int nth_root = 2;
 	float nthroot_inv = 1.f / nth_root;
 
-	fftw::dft_r2c_1d<float> fftw = fft_size;
-
 	// interpolation
-	tk::spline spline;
 	InterpolationType interp = InterpolationType::CSPLINE;
 
 	// output spectrum scale
@@ -67,13 +86,16 @@ private:
 	// window function
 	WindowFunction wf = WindowFunction::BLACKMAN;
 
+	// used by the non-const methods
+	Scratch scratch{fft_size};
+
 	// struct to hold the "max"s used in `calc_index_ratio`
 	struct
 	{
 		double linear, log, sqrt, cbrt, nthroot;
 		void set(const FrequencyAnalyzer &fa)
 		{
-			const auto max = fa.fftw.output_size();
+			const auto max = fa.fft_size / 2 + 1;
 			linear = max;
 			log = ::log(max);
 			sqrt = ::sqrt(max);
@@ -138,6 +160,7 @@ public:
 	 * @param wavedata input wave sample data, expected to be of size `fft_size`
 	 */
 	void copy_to_input(const float *wavedata);
+	void copy_to_input(Scratch &scratch, const float *wavedata) const;
 
 	/**
 	 * Copies a specific channel of the audio to the FFT processor, which is of size `fft_size`.
@@ -146,6 +169,8 @@ public:
 	 * @throws `std::invalid_argument` if `num_channels <= 0`
 	 */
 	void copy_channel_to_input(const float *audio, int num_channels, int channel, bool interleaved);
+	void copy_channel_to_input(
+		Scratch &scratch, const float *audio, int num_channels, int channel, bool interleaved) const;
 
 	/**
 	 * Renders a frequency spectrum using the stored wave data.
@@ -154,12 +179,37 @@ public:
 	 * @param spectrum Output vector to store resulting spectrum
 	 */
 	void render(std::vector<float> &spectrum);
+	void render(Scratch &scratch, std::vector<float> &spectrum) const;
+
+	/**
+	 * Renders a frequency spectrum from FFT amplitudes that were computed elsewhere,
+	 * e.g. by a `tt::AnalysisGraph` sharing one transform between several analyzers.
+	 * Only the bin mapping, accumulation and interpolation settings of this analyzer are used.
+	 * @param amplitudes `fft_size / 2 + 1` amplitudes, already normalized by `fft_size`
+	 * @param spectrum Output vector to store resulting spectrum
+	 */
+	void render_amplitudes(const float *amplitudes, std::vector<float> &spectrum);
+	void render_amplitudes(Scratch &scratch, const float *amplitudes, std::vector<float> &spectrum) const;
+
+	int get_fft_size() const { return fft_size; }
+	WindowFunction get_window_func() const { return wf; }
+
+	/**
+	 * @returns The value of window function `wf` at index `i` of a window `size` samples long.
+	 */
+	static float window(WindowFunction wf, int i, int size);
+
+	/**
+	 * @returns A `Scratch` owned by the calling thread, already sized for `fft_size`.
+	 * The last few sizes used on each thread are kept, so alternating between analyzers doesn't replan FFTs.
+	 */
+	static Scratch &thread_scratch(int fft_size);
 
 private:
 	float window_func(int i) const;
 	int calc_index(int i, int max_index) const;
 	float calc_index_ratio(float i) const;
-	void interpolate(std::vector<float> &spectrum);
+	void interpolate(Scratch &scratch, std::vector<float> &spectrum) const;
 };
 
 } // namespace tt
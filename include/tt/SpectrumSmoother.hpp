@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+namespace tt
+{
+
+/**
+ * Temporal smoothing of one channel's spectrum across frames.
+ * Each bin follows its input with separate attack (rising) and release (falling) rates,
+ * optionally followed by a peak hold that keeps the highest value for a number of frames before decaying.
+ *
+ * With smoothing, small FFT sizes look about as stable as large ones at a fraction of the cost.
+ * `process` is branchless and doesn't allocate unless the spectrum size changes.
+ */
+class SpectrumSmoother
+{
+	// fraction of the distance to the new value covered per frame; 1 means no smoothing
+	float attack, release;
+
+	int hold_frames{-1}; // negative: peak hold disabled
+	float peak_decay{1};
+
+	// state from the previous frame
+	std::vector<float> smoothed, peaks, held_for;
+
+public:
+	/**
+	 * @param attack in `(0, 1]`: how fast bins rise; 1 follows the input immediately
+	 * @param release in `(0, 1]`: how fast bins fall; lower values make bars fall more slowly
+	 */
+	SpectrumSmoother(float attack = 1, float release = 1);
+
+	void set_attack(float attack);
+	void set_release(float release);
+
+	/**
+	 * Keep every bin at its peak for `hold_frames` frames, then multiply the peak by `decay`
+	 * every frame until the (smoothed) input reaches it again.
+	 * @param hold_frames frames to hold a peak for; negative disables peak hold
+	 * @param decay in `[0, 1]`: factor the peak is multiplied by every frame after the hold
+	 */
+	void set_peak_hold(int hold_frames, float decay);
+
+	/**
+	 * Forget the previous frames, e.g. after seeking.
+	 */
+	void reset();
+
+	/**
+	 * Smooth `spectrum` in place against the previous frames.
+	 * A spectrum of a different size than last time resets the state.
+	 */
+	void process(std::vector<float> &spectrum);
+};
+
+} // namespace tt
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace tt
+{
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * All `capacity` elements are constructed up front and reused: the producer fills the slot
+ * returned by `back()` in place and then calls `push()`, the consumer reads `front()` and then calls `pop()`.
+ * Buffers inside the elements (e.g. `std::vector`s) therefore keep their allocations.
+ */
+template <typename T>
+class SpscQueue
+{
+	std::vector<T> slots;
+
+	// monotonically increasing; `tail - head` elements are queued.
+	// on separate cache lines, since each is written by a different thread
+	alignas(64) std::atomic<size_t> head{};
+	alignas(64) std::atomic<size_t> tail{};
+
+public:
+	/**
+	 * @param capacity maximum number of queued elements
+	 * @param init value every slot starts out as, e.g. a buffer of the right size
+	 */
+	SpscQueue(const int capacity, const T &init = {})
+		: slots(capacity, init)
+	{
+	}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	int capacity() const { return slots.size(); }
+
+	// approximate when called while the other thread is working on the queue
+	int size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+	/**
+	 * Producer only.
+	 * @returns The slot to fill before calling `push()`, or `nullptr` if the queue is full
+	 */
+	T *back()
+	{
+		const auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == slots.size())
+			return nullptr;
+		return &slots[t % slots.size()];
+	}
+
+	/**
+	 * Producer only. Publishes the slot returned by `back()`.
+	 */
+	void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	/**
+	 * Consumer only.
+	 * @returns The oldest element, or `nullptr` if the queue is empty
+	 */
+	T *front()
+	{
+		const auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &slots[h % slots.size()];
+	}
+
+	/**
+	 * Consumer only. Hands the slot returned by `front()` back to the producer.
+	 */
+	void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+} // namespace tt
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tt
+{
+
+/**
+ * Machine-readable progress of a run, written as JSON lines for e.g. a job scheduler to follow:
+ * - `{"event":"progress",...}` every `interval` seconds: output frames so far, position and duration of the media
+ * in seconds, `progress` from 0 to 1, render `fps`, `realtime` factor and `eta` in seconds over the last
+ * interval, and the average milliseconds of each stage of a frame as `stages`.
+ * Unknown values (e.g. the duration of live input) are `null`.
+ * - other events as they happen, e.g. `{"event":"start",...}`, each with the seconds since the start as `elapsed`.
+ * - `{"event":"end","ok":true|false}` last, after a final progress report; `ok` is false if an exception is
+ * unwinding the stack.
+ *
+ * The render loop only hands over numbers under a mutex in `frame`; formatting and writing happen on a
+ * side thread, so a slow reader can't stall rendering. If writing fails (e.g. the reader went away),
+ * telemetry stops with a message instead of failing the run.
+ */
+class Telemetry
+{
+	using Clock = std::chrono::steady_clock;
+
+public:
+	// a stage of a frame and the milliseconds it took, see `audioviz::get_stage_times`
+	using Stage = std::pair<std::string_view, float>;
+
+private:
+	struct StageTotal
+	{
+		std::string label;
+		double ms;
+		int count;
+	};
+
+	FILE *const file;
+	const Clock::duration interval;
+	const Clock::time_point start{Clock::now()};
+
+	std::mutex mutex;
+	std::condition_variable_any cv;
+
+	// guarded by `mutex`: what `frame` and `event` hand over, taken by the side thread
+	int64_t frames{};
+	double position{};
+	std::optional<double> duration;
+	std::vector<StageTotal> stage_totals;
+	std::vector<std::string> events;
+	bool ok{true};
+
+	// declared last, so that it's joined before anything it uses is destroyed
+	std::jthread reporter;
+
+public:
+	/**
+	 * @param dest where to write: a file path, `fd:<n>` for an open file descriptor (e.g. a pipe),
+	 * or `unix:<path>` to connect to a listening unix stream socket
+	 * @param interval seconds between progress reports
+	 * @throws `std::system_error` if `dest` can't be opened
+	 */
+	Telemetry(const std::string &dest, double interval = 1);
+
+	// writes a final progress report and the "end" event
+	~Telemetry();
+
+	Telemetry(const Telemetry &) = delete;
+	Telemetry &operator=(const Telemetry &) = delete;
+
+	/**
+	 * Count an output frame. Cheap enough to call after every frame, from any thread.
+	 * @param position seconds into the media
+	 * @param duration length of the media in seconds, if known
+	 * @param stages how long each stage of the frame took
+	 */
+	void frame(double position, std::optional<double> duration, std::span<const Stage> stages = {});
+
+	/**
+	 * Write an event line soon, e.g. `event("encode", {field("command", command)})`.
+	 */
+	void event(std::string_view name, std::initializer_list<std::string> fields = {});
+
+	// `"key":value` for `event`, with the value as a json string or number (`null` if not finite)
+	static std::string field(std::string_view key, std::string_view value);
+	static std::string field(std::string_view key, double value);
+
+private:
+	void report(std::stop_token st);
+
+	// the progress line since the last one; call with `mutex` held
+	std::string progress(Clock::time_point now, Clock::time_point &last, int64_t &last_frames, double &last_position);
+};
+
+} // namespace tt
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace tt
+{
+
+/**
+ * A small fixed-size pool of worker threads.
+ * Threads waiting on the pool (`parallel_for`, `wait`) run queued tasks themselves while they wait,
+ * so pool tasks can safely use the pool again.
+ */
+class ThreadPool
+{
+	std::vector<std::jthread> workers;
+	std::queue<std::move_only_function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping{};
+
+public:
+	/**
+	 * @param num_threads number of worker threads; the thread calling `parallel_for` also does work
+	 */
+	ThreadPool(int num_threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	/**
+	 * The pool shared by the analyzers. Uses one thread less than the hardware supports,
+	 * since the calling thread participates in `parallel_for`.
+	 */
+	static ThreadPool &shared();
+
+	int size() const { return workers.size(); }
+
+	/**
+	 * Queue `task` to run on a worker thread.
+	 * @returns A future that becomes ready when `task` finished, and rethrows its exception, if any.
+	 */
+	std::future<void> submit(std::move_only_function<void()> task);
+
+	/**
+	 * Calls `f(i)` for every `i` in `[0, n)`, spread across the pool and the calling thread.
+	 * Returns once all calls have finished. The first exception thrown by `f` is rethrown.
+	 */
+	void parallel_for(int n, const std::function<void(int)> &f);
+
+	/**
+	 * Wait for `future`, running queued tasks in the meantime.
+	 */
+	void wait(std::future<void> &future);
+
+private:
+	bool run_pending_task();
+};
+
+} // namespace tt
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace tt
+{
+
+/**
+ * Preallocated textures for video frames, used round-robin.
+ * Frames are read straight into mapped OpenGL pixel buffer objects and uploaded from there,
+ * so `push` returns while the GPU is still copying the frame into its texture. That copy
+ * then overlaps with decoding the next frame and drawing the previous one.
+ *
+ * Falls back to plain `sf::Texture::update` if pixel buffer objects aren't available.
+ * All methods need an active OpenGL context.
+ */
+class VideoFramePool
+{
+public:
+	/**
+	 * Reads the next `size` rgba frame into the given buffer.
+	 * @returns `false` if there are no more frames
+	 */
+	using FrameReader = std::function<bool(std::span<uint8_t>)>;
+
+	const sf::Vector2u size;
+
+private:
+	std::vector<sf::Texture> textures;
+	std::vector<unsigned> pbos; // empty if unsupported
+	std::vector<uint8_t> fallback_buffer;
+	int pushed{};
+
+public:
+	/**
+	 * @param size size of every frame
+	 * @param num_frames number of textures; three lets reading, uploading and drawing use different ones
+	 */
+	VideoFramePool(sf::Vector2u size, int num_frames = 3);
+	~VideoFramePool();
+
+	VideoFramePool(const VideoFramePool &) = delete;
+	VideoFramePool &operator=(const VideoFramePool &) = delete;
+
+	/**
+	 * Read the next frame with `read_frame` and start uploading it.
+	 * @returns `false` if `read_frame` did
+	 */
+	bool push(const FrameReader &read_frame);
+
+	/**
+	 * @returns The frame pushed before the most recent one, whose upload has had a whole frame to finish;
+	 * the most recent one right after the first push; `nullptr` before that
+	 */
+	const sf::Texture *front() const;
+
+	// forget the frames pushed so far, e.g. after seeking, so that `front()` shows the next push right away
+	inline void reset() { pushed = 0; }
+
+private:
+	void push_pbo(int slot, const FrameReader &read_frame, bool &read);
+};
+
+} // namespace tt
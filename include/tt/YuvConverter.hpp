@@ -0,0 +1,38 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <filesystem>
+
+namespace tt
+{
+
+/**
+ * Draws 4:2:0 yuv video frames that were uploaded as is into an rgba texture (see `Media::VideoFormat`),
+ * converting them to rgb in a fragment shader. This way neither ffmpeg nor the pipe nor the upload
+ * deal with 4 bytes per pixel. Chroma is upsampled nearest-neighbor, which is plenty for a background.
+ */
+class YuvConverter
+{
+	static inline sf::Shader shader = sf::Shader(std::filesystem::path{"shaders/yuv.frag"}, sf::Shader::Type::Fragment);
+
+public:
+	const sf::Vector2u size;
+	const bool nv12, bt709, full_range;
+
+	/**
+	 * @param size frame size in pixels; the width must be divisible by 4 and the height by 2
+	 * @param nv12 whether u and v are interleaved in one plane, instead of having a plane each
+	 * @param bt709 whether to use the bt.709 matrix instead of bt.601
+	 * @param full_range whether values span 0-255 instead of 16-235 (16-240 for chroma)
+	 * @throws `std::invalid_argument` if `size` doesn't pack into whole texels
+	 */
+	YuvConverter(sf::Vector2u size, bool nv12, bool bt709, bool full_range);
+
+	// size of the rgba texture that a frame is uploaded into
+	inline sf::Vector2u texture_size() const { return {size.x / 4, size.y * 3 / 2}; }
+
+	// convert the frame in `texture` into all of `target`, which should be `size` big
+	void draw(sf::RenderTarget &target, const sf::Texture &texture) const;
+};
+
+} // namespace tt
@@ -50,6 +50,11 @@ public:
 	 */
 	const std::string &get_name() const { return name; }
 
+	/**
+	 * @returns The "effects" render-texture, as of the last `apply_fx()`.
+	 */
+	const tt::RenderTexture &get_fx_rt() const { return _fx_rt; }
+
 	void orig_draw(const sf::Drawable &);
 	void orig_display();
 
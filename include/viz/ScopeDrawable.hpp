@@ -77,7 +77,7 @@ public:
 
 	size_t get_shape_count() const { return shapes.size(); }
 
-	void update_shape_positions(const std::span<float> &audio)
+	void update_shape_positions(const std::span<const float> audio)
 	{
 		assert(audio.size() >= shapes.size());
 
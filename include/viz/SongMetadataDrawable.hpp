@@ -20,8 +20,10 @@ class SongMetadataDrawable : public sf::Drawable
 
 public:
 	SongMetadataDrawable(sf::Text &title_text, sf::Text &artist_text);
+	// show the title and artist of `media`; the ones it doesn't have are cleared
 	void use_metadata(const Media &);
 	void set_album_cover(const sf::Texture &txr, const sf::Vector2f size);
+	void clear_album_cover();
 	void set_position(const sf::Vector2f pos);
 	void draw(sf::RenderTarget &target, const sf::RenderStates states) const override;
 
@@ -0,0 +1,56 @@
+#version 460 core
+
+// a 4:2:0 yuv frame uploaded as is into an rgba texture: texel bytes are the frame's bytes, in order
+uniform sampler2D frame;
+
+// frame size in pixels
+uniform ivec2 size;
+
+// u and v interleaved instead of a plane each; bt.709 instead of bt.601; 0-255 instead of 16-235
+uniform bool nv12, bt709, full_range;
+
+out vec4 color;
+
+// byte `i` of the frame, normalized
+float byte_at(const int i)
+{
+	const int row = textureSize(frame, 0).x;
+	const int texel = i / 4;
+	return texelFetch(frame, ivec2(texel % row, texel / row), 0)[i % 4];
+}
+
+void main()
+{
+	// render-textures are upside down, while the frame starts with its top row
+	const ivec2 p = ivec2(gl_FragCoord.x, size.y - 1 - int(gl_FragCoord.y));
+	const int luma = size.x * size.y;
+
+	// each chroma sample covers 2x2 pixels
+	const int c = (p.y / 2) * (size.x / 2) + p.x / 2;
+
+	float y = byte_at(p.y * size.x + p.x), u, v;
+	if (nv12)
+	{
+		u = byte_at(luma + 2 * c);
+		v = byte_at(luma + 2 * c + 1);
+	}
+	else
+	{
+		u = byte_at(luma + c);
+		v = byte_at(luma + luma / 4 + c);
+	}
+
+	u -= 128. / 255;
+	v -= 128. / 255;
+	if (!full_range)
+	{
+		y = (y - 16. / 255) * (255. / 219);
+		u *= 255. / 224;
+		v *= 255. / 224;
+	}
+
+	const vec3 rgb = bt709
+		? vec3(y + 1.5748 * v, y - 0.187324 * u - 0.468124 * v, y + 1.8556 * u)
+		: vec3(y + 1.402 * v, y - 0.344136 * u - 0.714136 * v, y + 1.772 * u);
+	color = vec4(clamp(rgb, 0, 1), 1);
+}
@@ -3,7 +3,9 @@
 Args::Args(const int argc, const char *const *const argv)
 	: ArgumentParser(argv[0], "latest")
 {
-	add_argument("media_url");
+	add_argument("media_url")
+		.help("media file or url to visualize\nfor live input: '-' or 'fd:<n>' reads raw f32le audio from stdin or a file descriptor (requires '--raw-f32'),\n'pa:default' or 'pa:<device index>' captures from a portaudio input device\nseveral files, or .m3u/.m3u8 playlists of them, are played back to back as one gapless playlist:\nthe next track is loaded while the current one plays, tracks are resampled and downmixed to match the first,\nand video isn't decoded. when encoding with '-c:a copy', all tracks must have the same audio codec and parameters")
+		.nargs(argparse::nargs_pattern::at_least_one);
 
 	// clang-format off
 	add_argument("-n", "--sample-size")
@@ -111,6 +113,15 @@ Args::Args(const int argc, const char *const *const argv)
 		.nargs(1, 3)
 		.validate();
 
+	add_argument("--analyze-only")
+		.help("don't render anything: write per-frame spectra, band energies and levels to a .npy file\nuses the analyzer settings (-n, -s, -a, -w, -i, --nth-root) and -r; load with numpy.load(path, mmap_mode='r')");
+
+	add_argument("--analyze-bins")
+		.help("number of spectrum bins per channel written by --analyze-only")
+		.default_value(128u)
+		.scan<'u', uint>()
+		.validate();
+
 	add_argument("--enc-window")
 		.help("when used with --encode, renders the current frame being encoded to a window")
 		.flag();
@@ -124,10 +135,104 @@ Args::Args(const int argc, const char *const *const argv)
 		.scan<'u', uint>()
 		.validate();
 
+	add_argument("--media-backend")
+		.help("how to decode the media: 'libav' in-process, through ffmpeg processes with 'ffmpeg-boost' or 'ffmpeg-popen',\nor 'wav' to memory-map a pcm wav file\n'auto' picks one based on the container and codecs; see test/media-bench to compare them")
+		.choices("auto", "libav", "ffmpeg-boost", "ffmpeg-popen", "wav")
+		.default_value("auto");
+
+	add_argument("--raw-f32")
+		.help("read the media file as headerless interleaved 32-bit float samples; args: <sample rate> <channels>\nit's memory-mapped instead of decoded, like '--media-backend wav'\nalso the format of live input, see 'media_url'")
+		.nargs(2)
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--pcm-cache")
+		.help("keep decoded audio of compressed media in this directory, so that it's only decoded once\nlater runs memory-map it like a wav file; can be shared by concurrent runs");
+
+	add_argument("--pcm-cache-size")
+		.help("size limit of '--pcm-cache' in MiB; least recently used entries are deleted first")
+		.default_value(4096u)
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--downmix")
+		.help("mix the audio's channels before analyzing and playing it\n- 'auto': mono, 5.1 and 7.1 to stereo, everything else as is\n- 'itu': like 'auto', but fail for other layouts\n- 'none': use the first two channels\n- a matrix: one row of comma-separated coefficients per output channel, rows separated by ';'\n  e.g. '1,0,0.7,0,0.7,0;0,1,0.7,0,0,0.7' for 5.1 to stereo")
+		.default_value("auto");
+
+	add_argument("--live-block")
+		.help("frames per block of live input; smaller blocks lower latency at the cost of more wakeups")
+		.default_value(256u)
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--pcm-s16")
+		.help("have ffmpeg send 16-bit instead of 32-bit float audio through its pipe\nhalves the pipe bandwidth; 16 bits are plenty for visualization")
+		.flag();
+
+	add_argument("--sws-flags")
+		.help("swscale algorithm for video backgrounds when no gpu scaling works, e.g. 'fast_bilinear', 'bicubic'\nthe fastest working scaling path is probed once per host and cached in $XDG_CACHE_HOME/audioviz")
+		.default_value("bilinear");
+
+	add_argument("--ffmpeg-bg-fx")
+		.help("let ffmpeg apply the default video background effects while decoding, instead of rendering them every frame
+only the ffmpeg media backends can; has no effect with '--no-fx'")
+		.flag();
+
+	add_argument("--yuv-video")
+		.help("have ffmpeg pipe video backgrounds as 4:2:0 yuv and convert them in a shader, instead of converting to rgba\nless than half the pipe and upload bandwidth; needs a width divisible by 4 and an even height, and an ffmpeg media backend")
+		.flag();
+
+	add_argument("--prefetch")
+		.help("decode audio and video this many frames ahead on a background thread\nkeeps pipe reads and decoding off the render thread")
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--telemetry")
+		.help("write progress as json lines: frames, position, duration, progress, fps, realtime factor, eta and per-stage timings,\nplus start/encode/end events; for job schedulers instead of scraping stdout\narg: a file path, 'fd:<n>' for an open file descriptor, or 'unix:<path>' to connect to a unix socket");
+
+	add_argument("--telemetry-interval")
+		.help("seconds between --telemetry progress reports")
+		.default_value(1.f)
+		.scan<'f', float>()
+		.validate();
+
 	add_argument("--no-vsync")
 		.help("disable vsync (not recommended)")
 		.flag();
 
+	add_argument("--ps-sample-size")
+		.help("give the particles their own analyzer with this many audio samples per frame\nparticles only need a coarse bass estimate, so this can be much lower than '-n'")
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--ps-bins")
+		.help("with '--ps-sample-size': number of frequency bins the particles' analyzer computes\nthe particles only react to the overall bass level, so a few dozen bins are plenty")
+		.default_value(64u)
+		.scan<'u', uint>()
+		.validate();
+
+	add_argument("--stem")
+		.help("add a stem: a separate audio file (e.g. drums, vocals) with its own spectrum drawn over the main one\ncan be given multiple times; stems use the analyzer and spectrum args of the main spectrum")
+		.append();
+
+	add_argument("--smooth")
+		.help("smooth the spectrum over time; args: <attack> <release>\nboth in (0, 1]: the fraction of the way bars move towards their new height per frame when rising/falling\nlets a smaller '-n' look as stable as a large one, e.g. '-n 1024 --smooth 0.7 0.15'")
+		.nargs(2)
+		.scan<'f', float>()
+		.validate();
+
+	add_argument("--peak-hold")
+		.help("keep spectrum bars at their peak for a while; args: <frames> <decay>\nafter <frames> frames, the peak is multiplied by <decay> (in [0, 1]) every frame")
+		.nargs(2)
+		.scan<'f', float>()
+		.validate();
+
+	add_argument("--ps-smooth")
+		.help("requires '--ps-sample-size'\nsmooth the particles' analysis over time; args: <attack> <release>, see '--smooth'")
+		.nargs(2)
+		.scan<'f', float>()
+		.validate();
+
 	add_argument("--ps-startside")
 		.help("start side of particles: 'top', 'bottom', 'left', 'right'")
 		.choices("top", "bottom", "left", "right")
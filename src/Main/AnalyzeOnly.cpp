@@ -0,0 +1,152 @@
+#include "Main.hpp"
+#include "tt/AnalysisGraph.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+/**
+ * --analyze-only output format: a NumPy .npy file (format version 1.0) containing a
+ * 1-dimensional array of records, one record per video frame (see -r). all fields are little-endian float32:
+ * - `spectrum`: (channels, bins) spectrum rendered with the analyzer args (-n, -s, -a, -w, -i, --nth-root)
+ * - `bands`: (channels, 7) energy of the raw fft amplitudes in each of the bands in `band_edges`
+ * - `levels`: (channels, 2) rms and peak of the audio frames that belong to the video frame
+ *
+ * numpy users can simply `numpy.load(path, mmap_mode='r')`. everyone else: the header is always
+ * `header_size` bytes long, followed by the records. each record is `channels * (bins + 7 + 2)` floats
+ * in the order listed above.
+ */
+
+// size of the whole npy header (magic + version + length + dict + padding), a multiple of 64 as the format requires
+static constexpr auto header_size = 256;
+
+// sub-bass, bass, low-mids, mids, upper-mids, presence, brilliance
+static constexpr std::array<float, 8> band_edges{20, 60, 250, 500, 2000, 4000, 6000, 20000};
+static constexpr auto num_bands = band_edges.size() - 1;
+
+// writes the header for `frames` records; called again with the final count once analysis is done
+static void write_npy_header(std::ostream &out, const int channels, const int bins, const size_t frames)
+{
+	std::ostringstream dict;
+	dict << "{'descr': [('spectrum', '<f4', (" << channels << ", " << bins << ")), ";
+	dict << "('bands', '<f4', (" << channels << ", " << num_bands << ")), ";
+	dict << "('levels', '<f4', (" << channels << ", 2))], ";
+	dict << "'fortran_order': False, 'shape': (" << frames << ",), }";
+
+	// magic (6) + version (2) + header length (2)
+	constexpr auto preamble_size = 10;
+	auto header = dict.str();
+	if (preamble_size + header.size() + 1 > header_size)
+		throw std::runtime_error{"--analyze-only: npy header too large; too many channels?"};
+	header.resize(header_size - preamble_size - 1, ' ');
+	header += '\n';
+
+	const uint16_t header_len = header.size();
+	out.write("\x93NUMPY\x01\x00", 8);
+	out.put(header_len & 0xff);
+	out.put(header_len >> 8);
+	out << header;
+}
+
+void Main::analyze_only(const std::string &outfile)
+{
+	use_analyzer_args();
+
+	const auto framerate = args.get<uint>("-r");
+	const int bins = args.get<uint>("--analyze-bins");
+
+	// no video size, so no video decoder is spawned
+	const auto media = open_media({});
+	const auto nb_channels = media->nb_channels();
+	const auto sample_rate = media->sample_rate();
+	const int afpvf = sample_rate / framerate;
+
+	tt::AudioAnalyzer aa{nb_channels};
+	aa.resize(bins);
+	tt::AnalysisGraph analysis;
+	analysis.add(fa, aa);
+
+	// the levels are computed over the frames belonging to one video frame, which can be more than the fft needs
+	const auto frames_needed = std::max(analysis.required_frames(), afpvf);
+
+	std::ofstream out{outfile, std::ios::binary};
+	if (!out)
+		throw std::runtime_error{"--analyze-only: failed to open " + outfile};
+	write_npy_header(out, nb_channels, bins, 0);
+
+	std::vector<float> record;
+	record.reserve(nb_channels * (bins + num_bands + 2));
+	size_t frames{};
+
+	if (telemetry)
+		telemetry->event("analyze", {tt::Telemetry::field("output", outfile)});
+
+	const auto start = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		media->decode_audio(frames_needed);
+		const auto &audio = media->audio_buffer();
+		if (audio.frames() < frames_needed)
+			break;
+
+		analysis.analyze(audio.channels(), nb_channels);
+		record.clear();
+
+		for (int ch = 0; ch < nb_channels; ++ch)
+		{
+			const auto &spectrum = aa.get_spectrum_data(ch);
+			record.insert(record.end(), spectrum.begin(), spectrum.end());
+		}
+
+		for (int ch = 0; ch < nb_channels; ++ch)
+		{
+			const auto &amplitudes = analysis.get_amplitudes(fa, ch);
+			const auto hz_per_bin = (float)sample_rate / fa.get_fft_size();
+			std::array<float, num_bands> energies{};
+			for (int i = 0; i < (int)amplitudes.size(); ++i)
+			{
+				const auto freq = i * hz_per_bin;
+				for (int b = 0; b < (int)num_bands; ++b)
+					if (freq >= band_edges[b] && freq < band_edges[b + 1])
+					{
+						energies[b] += amplitudes[i] * amplitudes[i];
+						break;
+					}
+			}
+			record.insert(record.end(), energies.begin(), energies.end());
+		}
+
+		for (int ch = 0; ch < nb_channels; ++ch)
+		{
+			const auto samples = audio.channel(ch).first(afpvf);
+			float sum_squares{}, peak{};
+			for (const auto sample : samples)
+			{
+				sum_squares += sample * sample;
+				peak = std::max(peak, std::abs(sample));
+			}
+			record.push_back(std::sqrt(sum_squares / afpvf));
+			record.push_back(peak);
+		}
+
+		out.write(reinterpret_cast<const char *>(record.data()), record.size() * sizeof(float));
+		media->audio_buffer_erase(afpvf);
+		++frames;
+		if (telemetry)
+			telemetry->frame((double)frames * afpvf / sample_rate, media->duration());
+	}
+
+	// now that we know the number of records, rewrite the header with the real shape
+	out.seekp(0);
+	write_npy_header(out, nb_channels, bins, frames);
+	if (!out)
+		throw std::runtime_error{"--analyze-only: failed to write " + outfile};
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	const auto audio_sec = (double)frames / framerate;
+	std::cout << "analyzed " << frames << " frames (" << audio_sec << "s of audio) in " << elapsed.count() << "s, "
+			  << (audio_sec / elapsed.count()) << "x realtime\n";
+}
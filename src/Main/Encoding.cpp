@@ -1,12 +1,54 @@
 #include "Main.hpp"
+#include "media/VideoScalePath.hpp"
 
+#include <fstream>
 #include <future>
+#include <iostream>
 #include <queue>
+#include <random>
+#include <tuple>
 
 #define future_not_finished(f) f.wait_for(std::chrono::seconds(0)) != std::future_status::ready
 
+// quoted for the shell that `popen` runs
+static std::string quoted(const std::string &arg)
+{
+#ifdef _WIN32
+	return '"' + arg + '"';
+#else
+	if (arg.contains('\''))
+		return '"' + arg + '"';
+	return '\'' + arg + '\'';
+#endif
+}
+
+// whether the tracks' audio can be joined without decoding it: same codec, sample rate and channels
+static bool same_audio_format(const std::vector<std::string> &urls)
+{
+	std::optional<std::tuple<AVCodecID, int, int>> first;
+	for (const auto &url : urls)
+		try
+		{
+			const auto params = av::MediaReader{url}.find_best_stream(AVMEDIA_TYPE_AUDIO)->codecpar;
+			const std::tuple format{params->codec_id, params->sample_rate, params->ch_layout.nb_channels};
+			if (!first)
+				first = format;
+			else if (format != *first)
+				return false;
+		}
+		catch (const std::exception &)
+		{
+			return false;
+		}
+	return true;
+}
+
 Main::FfmpegEncoder::FfmpegEncoder(
-	audioviz &viz, const std::string &outfile, const std::string &vcodec, const std::string &acodec)
+	audioviz &viz,
+	const std::vector<std::string> &audio_urls,
+	const std::string &outfile,
+	const std::string &vcodec,
+	const std::string &acodec)
 {
 	std::ostringstream _ss;
 	_ss << "ffmpeg -hide_banner -y ";
@@ -22,22 +64,57 @@ Main::FfmpegEncoder::FfmpegEncoder(
 	_ss << "-ss -0.1 "; // THIS IS NECESSARY TO AVOID A/V DESYNC
 						// starts muxing this input 0.1 seconds earlier than the other
 
-#ifdef _WIN32
-	_ss << "-i \"" << viz.get_media_url() << "\" ";
-#else
-	if (viz.get_media_url().contains('\''))
-		_ss << "-i \"" << viz.get_media_url() << "\" ";
+	std::string audio_map = "1:a", audio_codec = acodec;
+	if (audio_urls.size() == 1)
+		_ss << "-i " << quoted(audio_urls.front()) << ' ';
+	else if (acodec == "copy" && same_audio_format(audio_urls))
+	{
+		// copying needs the tracks joined before decoding: the concat demuxer reads them as one input
+		concat_list = std::filesystem::temp_directory_path() /
+					  ("audioviz-" + std::to_string(std::random_device{}()) + ".ffconcat");
+		std::ofstream list{concat_list};
+		list << "ffconcat version 1.0\n";
+		for (const auto &url : audio_urls)
+		{
+			auto path = url.contains("://") ? url : std::filesystem::absolute(url).string();
+			// single quotes are closed, escaped and reopened
+			for (size_t i = 0; (i = path.find('\'', i)) != std::string::npos; i += 4)
+				path.replace(i, 1, "'\\''");
+			list << "file '" << path << "'\n";
+		}
+		if (!list.flush())
+			throw std::runtime_error{"can't write ffconcat list: " + concat_list.string()};
+		_ss << "-f concat -safe 0 -i " << quoted(concat_list.string()) << ' ';
+	}
 	else
-		_ss << "-i '" << viz.get_media_url() << "' ";
-#endif
+	{
+		// re-encoding: the concat filter decodes every track and converts them to a common format first
+		for (const auto &url : audio_urls)
+			_ss << "-i " << quoted(url) << ' ';
+		std::string filter;
+		for (int i = 1; i <= (int)audio_urls.size(); ++i)
+			filter += '[' + std::to_string(i) + ":a]";
+		filter += "concat=n=" + std::to_string(audio_urls.size()) + ":v=0:a=1[a]";
+		_ss << "-filter_complex " << quoted(filter) << ' ';
+		audio_map = "[a]";
+
+		// filtered audio can't be copied; ffmpeg picks the output format's default encoder instead
+		if (acodec == "copy")
+		{
+			std::cerr << "the playlist's tracks differ in codec, sample rate or channels, so their audio is re-encoded\n";
+			audio_codec.clear();
+		}
+	}
 
 	// specific stream mapping
-	_ss << "-map 0 ";	// use input 0
-	_ss << "-map 1:a "; // only use the AUDIO stream of input 1 (in case it might also have a video stream)
+	_ss << "-map 0 "; // use input 0
+	// only use the AUDIO stream of input 1 (in case it might also have a video stream), or the concatenated tracks
+	_ss << "-map " << quoted(audio_map) << ' ';
 
 	// specify encoders
 	_ss << "-c:v " << vcodec << ' ';
-	_ss << "-c:a " << acodec << ' ';
+	if (!audio_codec.empty())
+		_ss << "-c:a " << audio_codec << ' ';
 
 	// end on shortest input stream
 	_ss << "-shortest ";
@@ -45,22 +122,19 @@ Main::FfmpegEncoder::FfmpegEncoder(
 #ifdef LINUX
 	if (vcodec.contains("vaapi"))
 	{
-		_ss << "-vaapi_device /dev/dri/renderD129 ";
+		// a render node that was probed to work, instead of guessing one
+		const auto &devices = VideoScalePath::working_vaapi_devices();
+		if (devices.empty())
+			throw std::runtime_error{"no working vaapi device found for " + vcodec + "; use a software encoder"};
+		_ss << "-vaapi_device " << quoted(devices.front()) << ' ';
 		_ss << "-vf 'format=nv12,hwupload' ";
 	}
 #endif
 
 	// output file
-#ifdef _WIN32
-	_ss << '"' << outfile << "\" ";
-#else
-	if (outfile.contains('\''))
-		_ss << '"' << outfile << "\" ";
-	else
-		_ss << '\'' << outfile << "' ";
-#endif
+	_ss << quoted(outfile) << ' ';
 
-	const auto &command = _ss.str();
+	command = _ss.str();
 	std::cout << command << '\n';
 	process = popen(command.c_str(), "w");
 }
@@ -69,6 +143,11 @@ Main::FfmpegEncoder::~FfmpegEncoder()
 {
 	if (pclose(process) == -1)
 		perror("pclose");
+	if (!concat_list.empty())
+	{
+		std::error_code ec;
+		std::filesystem::remove(concat_list, ec);
+	}
 }
 
 void Main::FfmpegEncoder::send_frame(const sf::Texture &txr)
@@ -82,6 +161,13 @@ void Main::FfmpegEncoder::send_frame(const sf::Image &img)
 	fwrite(img.getPixelsPtr(), 4 * x * y, 1, process);
 }
 
+void Main::report_encode(const std::string &outfile, const FfmpegEncoder &ffmpeg)
+{
+	if (telemetry)
+		telemetry->event(
+			"encode", {tt::Telemetry::field("output", outfile), tt::Telemetry::field("command", ffmpeg.get_command())});
+}
+
 void Main::encode(audioviz &viz, const std::string &outfile, const std::string &vcodec, const std::string &acodec)
 {
 	if (enc_window)
@@ -93,9 +179,10 @@ void Main::encode(audioviz &viz, const std::string &outfile, const std::string &
 void Main::encode_without_window(
 	audioviz &viz, const std::string &outfile, const std::string &vcodec, const std::string &acodec)
 {
-	FfmpegEncoder ffmpeg{viz, outfile, vcodec, acodec};
+	FfmpegEncoder ffmpeg{viz, playlist, outfile, vcodec, acodec};
+	report_encode(outfile, ffmpeg);
 	tt::RenderTexture rt{viz.size, 4};
-	while (viz.prepare_frame())
+	while (prepare_frame(viz))
 	{
 		rt.draw(viz);
 		rt.display();
@@ -115,7 +202,7 @@ void Main::encode_without_window_mt(
 	const auto image_queuer = std::async(std::launch::async, [&]
 	{
 		tt::RenderTexture rt{viz.size, 4};
-		while (viz.prepare_frame())
+		while (prepare_frame(viz))
 		{
 			rt.draw(viz);
 			rt.display();
@@ -125,7 +212,8 @@ void Main::encode_without_window_mt(
 	});
 	// clang-format on
 
-	FfmpegEncoder ffmpeg{viz, outfile, vcodec, acodec};
+	FfmpegEncoder ffmpeg{viz, playlist, outfile, vcodec, acodec};
+	report_encode(outfile, ffmpeg);
 	while (future_not_finished(image_queuer))
 	{
 		if (images.empty())
@@ -138,7 +226,8 @@ void Main::encode_without_window_mt(
 void Main::encode_with_window(
 	audioviz &viz, const std::string &outfile, const std::string &vcodec, const std::string &acodec)
 {
-	FfmpegEncoder ffmpeg{viz, outfile, vcodec, acodec};
+	FfmpegEncoder ffmpeg{viz, playlist, outfile, vcodec, acodec};
+	report_encode(outfile, ffmpeg);
 	sf::RenderWindow window{
 		sf::VideoMode{viz.size},
 		"encoder",
@@ -147,7 +236,7 @@ void Main::encode_with_window(
 		{.antiAliasingLevel = 4},
 	};
 	sf::Texture txr{viz.size};
-	while (viz.prepare_frame())
+	while (prepare_frame(viz))
 	{
 		window.draw(viz);
 		window.display();
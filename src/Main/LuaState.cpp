@@ -24,7 +24,8 @@ Main::LuaState::LuaState(Main &main)
 
 	// add more args here!!!!!!!!!
 	create_named_table("args",
-		"media_url", main.args.get("media_url")
+		"media_url", main.playlist.front(),
+		"media_backend", main.args.get("--media-backend")
 	);
 
 	// wrapping arguments with std::ref ensures sol2 will not copy arguments
@@ -47,6 +48,14 @@ Main::LuaState::LuaState(Main &main)
 		"set_nth_root", &tt::FrequencyAnalyzer::set_nth_root
 	);
 
+	tt_namespace["SpectrumSmoother"] = new_usertype<tt::SpectrumSmoother>(
+		"", sol::constructors<tt::SpectrumSmoother(float, float)>(),
+		"set_attack", &tt::SpectrumSmoother::set_attack,
+		"set_release", &tt::SpectrumSmoother::set_release,
+		"set_peak_hold", &tt::SpectrumSmoother::set_peak_hold,
+		"reset", &tt::SpectrumSmoother::reset
+	);
+
 	viz_namespace["ParticleSystem"] = new_usertype<viz::ParticleSystem<ParticleShapeType>>(
 		"", sol::factories([](const sol::table &rect, const int particle_count)
 		{
@@ -95,6 +104,17 @@ Main::LuaState::LuaState(Main &main)
 			int antialiasing)
 		{
 			return std::make_shared<audioviz>(table_to_vec2u(rect), media_url, fa, ss, ps, antialiasing);
+		}, [](
+			const sol::table &rect,
+			const std::string &media_url,
+			tt::FrequencyAnalyzer &fa,
+			viz::StereoSpectrum<BarType> &ss,
+			viz::ParticleSystem<ParticleShapeType> &ps,
+			int antialiasing,
+			const std::string &media_backend)
+		{
+			return std::make_shared<audioviz>(table_to_vec2u(rect), media_url, fa, ss, ps, antialiasing,
+				media_backend_from_string(media_backend));
 		}),
 		"use_attached_pic_as_bg", &audioviz::use_attached_pic_as_bg,
 		"add_default_effects", &audioviz::add_default_effects,
@@ -107,7 +127,16 @@ Main::LuaState::LuaState(Main &main)
 		"set_framerate", &audioviz::set_framerate,
 		"set_spectrum_margin", &audioviz::set_spectrum_margin,
 		"set_text_font", &audioviz::set_text_font,
-		"set_fft_size", &audioviz::set_fft_size
+		"set_fft_size", &audioviz::set_fft_size,
+		"set_particle_analyzer", &audioviz::set_particle_analyzer,
+		"set_spectrum_smoother", &audioviz::set_spectrum_smoother,
+		"set_particle_smoother", &audioviz::set_particle_smoother,
+		"add_stem", sol::overload(
+			[](audioviz &self, const std::string &url, tt::FrequencyAnalyzer &fa, viz::StereoSpectrum<BarType> &ss)
+			{ self.add_stem(url, fa, ss); },
+			[](audioviz &self, const std::string &url, tt::FrequencyAnalyzer &fa, viz::StereoSpectrum<BarType> &ss,
+			   viz::ParticleSystem<ParticleShapeType> &ps)
+			{ self.add_stem(url, fa, ss, &ps); })
 	);
 	// clang-format on
 }
@@ -1,8 +1,114 @@
 #include "Main.hpp"
+#include "media/CaptureMedia.hpp"
+#include "media/FfmpegCliBoostMedia.hpp"
+#include "media/PipeInputMedia.hpp"
+#include "media/PlaylistMedia.hpp"
+#include "media/PrefetchMedia.hpp"
+#include "media/VideoScalePath.hpp"
+#include "media/WavMedia.hpp"
+
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static bool is_live(const std::string &url)
+{
+	return url == "-" || url.starts_with("fd:") || url.starts_with("pa:");
+}
+
+// expands .m3u/.m3u8 playlists into their entries; relative paths in them are relative to the playlist
+static std::vector<std::string> read_playlist(const std::vector<std::string> &urls)
+{
+	std::vector<std::string> tracks;
+	for (const auto &url : urls)
+	{
+		if (!url.ends_with(".m3u") && !url.ends_with(".m3u8"))
+		{
+			tracks.push_back(url);
+			continue;
+		}
+
+		std::ifstream in{url};
+		if (!in)
+			throw std::runtime_error{"can't open playlist: " + url};
+		const auto dir = std::filesystem::path{url}.parent_path();
+		for (std::string line; std::getline(in, line);)
+		{
+			// written on windows, or with a bom
+			if (line.ends_with('\r'))
+				line.pop_back();
+			if (line.starts_with("\xEF\xBB\xBF"))
+				line.erase(0, 3);
+			// comments and extended m3u directives
+			if (line.empty() || line.starts_with('#'))
+				continue;
+			if (line.contains("://") || std::filesystem::path{line}.is_absolute())
+				tracks.push_back(line);
+			else
+				tracks.push_back((dir / line).string());
+		}
+	}
+
+	if (tracks.empty())
+		throw std::invalid_argument{"media_url: the playlist is empty"};
+	// a live track would never end
+	if (tracks.size() > 1)
+		for (const auto &track : tracks)
+			if (is_live(track))
+				throw std::invalid_argument{"media_url: live input can't be part of a playlist: " + track};
+	return tracks;
+}
+
+static bool encoding(const Args &args)
+{
+	return !args.get<std::vector<std::string>>("--encode").empty();
+}
+
+// the tracks libav can open with an audio stream; the others are skipped with a message
+static std::vector<std::string> playable_tracks(const std::vector<std::string> &tracks)
+{
+	std::vector<std::string> playable;
+	for (const auto &track : tracks)
+		try
+		{
+			av::MediaReader{track}.find_best_stream(AVMEDIA_TYPE_AUDIO);
+			playable.push_back(track);
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "playlist: skipping '" << track << "': " << e.what() << '\n';
+		}
+	if (playable.empty())
+		throw std::invalid_argument{"media_url: none of the playlist's tracks can be played"};
+	return playable;
+}
+
+// the media urls as given, with playlists expanded
+static std::vector<std::string> read_tracks(const Args &args)
+{
+	auto tracks = read_playlist(args.get<std::vector<std::string>>("media_url"));
+	// the encoder takes the audio from the tracks themselves, so a track the playlist would skip while playing
+	// is left out up front instead, see `open_media`. raw samples can't be probed
+	if (tracks.size() > 1 && encoding(args) && !args.present<std::vector<uint>>("--raw-f32"))
+		tracks = playable_tracks(tracks);
+	return tracks;
+}
 
 Main::Main(const int argc, const char *const *const argv)
-	: args{argc, argv}
+	: args{argc, argv},
+	  playlist{read_tracks(args)}
 {
+	if (const auto dest = args.present("--telemetry"))
+	{
+		telemetry.emplace(*dest, args.get<float>("--telemetry-interval"));
+		telemetry->event(
+			"start",
+			{tt::Telemetry::field("media", playlist.front()), tt::Telemetry::field("tracks", playlist.size())});
+	}
+
 #ifdef AUDIOVIZ_LUA
 	// this is how things will be for now
 	if (const auto luafile = args.present("--luafile"))
@@ -13,9 +119,22 @@ Main::Main(const int argc, const char *const *const argv)
 	}
 #endif
 
+	// headless: no window, render textures or shaders are created
+	if (const auto outfile = args.present("--analyze-only"))
+	{
+		analyze_only(*outfile);
+		return;
+	}
+
 	const auto &size_args = args.get<std::vector<uint>>("--size");
 	const sf::Vector2u size{size_args[0], size_args[1]};
-	audioviz viz{size, args.get("media_url"), fa, ss, ps};
+	audioviz viz{
+		size,
+		open_media(size),
+		fa,
+		ss,
+		ps,
+	};
 	ps.set_rect({{}, (sf::Vector2i)size});
 	use_args(viz);
 
@@ -40,6 +159,102 @@ Main::Main(const int argc, const char *const *const argv)
 	}
 }
 
+std::unique_ptr<Media> Main::open_media(const sf::Vector2u size) const
+{
+	VideoScalePath::software_flags = args.get("--sws-flags");
+	if (playlist.size() == 1)
+		return open_track(playlist.front(), size);
+
+	// a video background couldn't carry over from one track to the next, so playlists are audio only.
+	// each track is opened and decoded ahead by the playlist's loader thread; only reads happen here.
+	// when encoding, a track that still fails fails the run, since the encoded audio would have it
+	return std::make_unique<PlaylistMedia>(
+		playlist,
+		[this](const std::string &url, const int sample_rate, const int nb_channels)
+		{ return open_track(url, {}, sample_rate, nb_channels); },
+		args.get<uint>("-n"),
+		!encoding(args));
+}
+
+std::unique_ptr<Media> Main::open_track(
+	const std::string &url, const sf::Vector2u size, const int sample_rate, const int nb_channels) const
+{
+	const auto raw = args.present<std::vector<uint>>("--raw-f32");
+	const int live_block = args.get<uint>("--live-block");
+	const int framerate = args.get<uint>("-r");
+	const bool yuv_video = args.get<bool>("--yuv-video");
+
+	// see `audioviz::add_default_effects`, which leaves out whatever the media applied
+	std::string video_filter;
+	if (args.get<bool>("--ffmpeg-bg-fx") && !args.get<bool>("--no-fx"))
+		video_filter = fx::Effect::ffmpeg_filters(audioviz::default_video_bg_effects()).value_or("");
+
+	std::unique_ptr<Media> media;
+	if (url == "-" || url.starts_with("fd:"))
+	{
+#ifndef _WIN32
+		if (!raw)
+			throw std::invalid_argument{"live input from a pipe requires --raw-f32 <sample rate> <channels>"};
+		const auto fd = (url == "-") ? STDIN_FILENO : std::stoi(url.substr(3));
+		media = std::make_unique<PipeInputMedia>(url, fd, (*raw)[0], (*raw)[1], live_block);
+#else
+		throw std::runtime_error{"live input from a pipe isn't supported on windows"};
+#endif
+	}
+	else if (url.starts_with("pa:"))
+	{
+#ifdef AUDIOVIZ_PORTAUDIO
+		media = std::make_unique<CaptureMedia>(url.substr(3), raw ? (*raw)[0] : 0, raw ? (*raw)[1] : 0, live_block);
+#else
+		throw std::runtime_error{"audioviz was built without portaudio, so it can't capture audio"};
+#endif
+	}
+	else if (raw)
+		media = std::make_unique<WavMedia>(url, (*raw)[0], (*raw)[1]);
+	else if (const auto dir = args.present("--pcm-cache"))
+		media = create_media(
+			url,
+			size,
+			media_backend(),
+			pcm_format(),
+			framerate,
+			video_filter,
+			yuv_video,
+			PcmCache{*dir, args.get<uint>("--pcm-cache-size") * (1ull << 20)});
+	else
+		media = create_media(url, size, media_backend(), pcm_format(), framerate, video_filter, yuv_video);
+
+	// only ffmpeg resamples, so a track at another rate is opened again with it. that skips the pcm cache,
+	// whose entries are at the track's own rate
+	if (sample_rate && media->sample_rate() != sample_rate && !raw)
+		media = std::make_unique<FfmpegCliBoostMedia>(
+			url, size, pcm_format(), framerate, video_filter, yuv_video, sample_rate);
+
+	const auto decoded_channels = media->nb_channels();
+	auto matrix = downmix(decoded_channels);
+	// e.g. a mono track in a stereo playlist
+	if (nb_channels == 2 && (matrix ? matrix->out_channels() : decoded_channels) != 2)
+		matrix = DownmixMatrix::itu_stereo(decoded_channels);
+	media->set_downmix(matrix);
+	// live input has nothing to read ahead, and queueing it would only add latency
+	if (const auto depth = args.present<uint>("--prefetch"); depth && !dynamic_cast<LiveMedia *>(media.get()))
+	{
+		// one block per video frame, matching what `prepare_frame` consumes
+		const int block_frames = media->sample_rate() / framerate;
+		media = std::make_unique<PrefetchMedia>(std::move(media), *depth, block_frames, *depth);
+	}
+	return media;
+}
+
+bool Main::prepare_frame(audioviz &viz)
+{
+	if (!viz.prepare_frame())
+		return false;
+	if (telemetry)
+		telemetry->frame(viz.position(), viz.duration(), viz.get_stage_times());
+	return true;
+}
+
 void Main::start_in_window(audioviz &viz)
 {
 #ifdef AUDIOVIZ_PORTAUDIO
@@ -55,13 +270,34 @@ void Main::start_in_window(audioviz &viz)
 	};
 	window.setVerticalSyncEnabled(!no_vsync);
 
-	while (window.isOpen() && viz.prepare_frame())
+	// left/right scrub 5 seconds, 30 with shift; home goes back to the start
+	if (viz.seekable())
+		viz.load_seek_index();
+
+	while (window.isOpen() && prepare_frame(viz))
 	{
 		window.draw(viz);
 		window.display();
 		while (const auto event = window.pollEvent())
+		{
 			if (event->is<sf::Event::Closed>())
 				window.close();
+			else if (const auto key = event->getIf<sf::Event::KeyPressed>(); key && viz.seekable())
+				switch (const auto step = key->shift ? 30 : 5; key->code)
+				{
+				case sf::Keyboard::Key::Left:
+					viz.scrub(-step);
+					break;
+				case sf::Keyboard::Key::Right:
+					viz.scrub(step);
+					break;
+				case sf::Keyboard::Key::Home:
+					viz.seek(0);
+					break;
+				default:
+					break;
+				}
+		}
 		window.clear();
 	}
 }
@@ -1,14 +1,14 @@
 #include "Main.hpp"
 
+#include <cmath>
+
 void Main::use_args(audioviz &viz)
 {
-	// default-value params
-	viz.set_fft_size(args.get<uint>("-n"));
+	use_analyzer_args();
 
-	ss.set_multiplier(args.get<float>("-m"));
-	ss.set_bar_width(args.get<uint>("-bw"));
-	ss.set_bar_spacing(args.get<uint>("-bs"));
+	use_spectrum_args(ss);
 
+	// default-value params
 	viz.set_framerate(args.get<uint>("-r"));
 	no_vsync = args.get<bool>("--no-vsync");
 	enc_window = args.get<bool>("--enc-window");
@@ -22,6 +22,16 @@ void Main::use_args(audioviz &viz)
 	else
 		viz.use_attached_pic_as_bg(); // THIS NEEDS TO BE HERE OTHERWISE THE BACKGROUND BREAKS!!!!!!!!!!!!!
 
+	if (const auto stem_urls = args.present<std::vector<std::string>>("--stem"))
+		for (int i = 0; i < (int)stem_urls->size(); ++i)
+		{
+			// spread the stems' hues evenly around the color wheel so they can be told apart
+			auto &stem_ss = this->stem_ss.emplace_back();
+			use_spectrum_args(stem_ss, (i + 1.f) / (stem_urls->size() + 1));
+			viz.add_stem(stem_urls->at(i), fa, stem_ss);
+		}
+
+	// stems need to be added before this so that their layers get effects too
 	if (!args.get<bool>("--no-fx"))
 		viz.add_default_effects();
 
@@ -31,43 +41,6 @@ void Main::use_args(audioviz &viz)
 	if (const auto font_path = args.present("--font"))
 		viz.set_text_font(*font_path);
 
-	{ // accumulation method
-		static const std::unordered_map<std::string, FA::AccumulationMethod> am_map{
-			{"sum", FA::AccumulationMethod::SUM},
-			{"max", FA::AccumulationMethod::MAX},
-		};
-
-		const auto &am_str = args.get("-a");
-
-		try
-		{
-			fa.set_accum_method(am_map.at(am_str));
-		}
-		catch (std::out_of_range)
-		{
-			throw std::invalid_argument{"--accum-method: unknown accumulation method: " + am_str};
-		}
-	}
-
-	{ // window function
-		static const std::unordered_map<std::string, FA::WindowFunction> wf_map{
-			{"hanning", FA::WindowFunction::HANNING},
-			{"hamming", FA::WindowFunction::HAMMING},
-			{"blackman", FA::WindowFunction::BLACKMAN},
-		};
-
-		const auto &wf_str = args.get("-w");
-
-		try
-		{
-			fa.set_window_func(wf_map.at(wf_str));
-		}
-		catch (std::out_of_range)
-		{
-			throw std::invalid_argument{"--window-func: unknown window function: " + wf_str};
-		}
-	}
-
 	{ // start position of particles
 		static const std::unordered_map<std::string, PS::StartSide> pos_map{
 			{"top", PS::StartSide::TOP},
@@ -88,45 +61,6 @@ void Main::use_args(audioviz &viz)
 		}
 	}
 
-	{ // interpolation type
-		static const std::unordered_map<std::string, FA::InterpolationType> it_map{
-			{"none", FA::InterpolationType::NONE},
-			{"linear", FA::InterpolationType::LINEAR},
-			{"cspline", FA::InterpolationType::CSPLINE},
-			{"cspline_hermite", FA::InterpolationType::CSPLINE_HERMITE}};
-
-		const auto &it_str = args.get("-i");
-
-		try
-		{
-			fa.set_interp_type(it_map.at(it_str));
-		}
-		catch (std::out_of_range)
-		{
-			throw std::invalid_argument{"--interp-type: unknown interpolation type: " + it_str};
-		}
-	}
-
-	{ // spectrum coloring type
-		const auto &color_str = args.get("--color");
-		if (color_str == "wheel")
-		{
-			ss.set_color_mode(SD::ColorMode::WHEEL);
-			const auto &hsv = args.get<std::vector<float>>("--hsv");
-			assert(hsv.size() == 3);
-			ss.set_color_wheel_hsv({hsv[0], hsv[1], hsv[2]});
-			ss.set_color_wheel_rate(args.get<float>("--wheel-rate"));
-		}
-		else if (color_str == "solid")
-		{
-			ss.set_color_mode(SD::ColorMode::SOLID);
-			const auto &rgb = args.get<std::vector<uint8_t>>("--rgb");
-			ss.set_solid_color({rgb[0], rgb[1], rgb[2]});
-		}
-		else
-			throw std::invalid_argument{"--color: unknown coloring type: " + color_str};
-	}
-
 	{ // spectrum blendmode
 		static const std::unordered_map<std::string, sf::BlendMode::Factor> factor_map{
 			{"0", sf::BlendMode::Factor::Zero},
@@ -197,6 +131,159 @@ void Main::use_args(audioviz &viz)
 		}
 	}
 
+	if (const auto ps_sample_size = args.present<uint>("--ps-sample-size"))
+	{
+		const auto ps_bins = args.get<uint>("--ps-bins");
+		if (!ps_bins)
+			throw std::invalid_argument{"--ps-bins must be at least 1"};
+		ps_fa.emplace(*ps_sample_size);
+		viz.set_particle_analyzer(*ps_fa, ps_bins);
+	}
+
+	{ // temporal smoothing
+		const auto smooth = args.present<std::vector<float>>("--smooth");
+		const auto peak_hold = args.present<std::vector<float>>("--peak-hold");
+		if (smooth || peak_hold)
+		{
+			tt::SpectrumSmoother smoother;
+			if (smooth)
+			{
+				smoother.set_attack(smooth->at(0));
+				smoother.set_release(smooth->at(1));
+			}
+			if (peak_hold)
+			{
+				// scanned as float along with <decay>
+				const auto frames = peak_hold->at(0);
+				if (frames < 0 || frames != std::trunc(frames))
+					throw std::invalid_argument{"--peak-hold: <frames> must be a whole number, at least 0"};
+				smoother.set_peak_hold(frames, peak_hold->at(1));
+			}
+			viz.set_spectrum_smoother(smoother);
+		}
+
+		if (const auto ps_smooth = args.present<std::vector<float>>("--ps-smooth"))
+		{
+			if (!ps_fa)
+				throw std::invalid_argument{"--ps-smooth requires --ps-sample-size"};
+			viz.set_particle_smoother({ps_smooth->at(0), ps_smooth->at(1)});
+		}
+	}
+}
+
+MediaBackend Main::media_backend() const
+{
+	return media_backend_from_string(args.get("--media-backend"));
+}
+
+std::optional<DownmixMatrix> Main::downmix(const int nb_channels) const
+{
+	const auto &spec = args.get("--downmix");
+	if (spec == "none")
+		return {};
+	if (spec == "auto")
+		return DownmixMatrix::itu_stereo(nb_channels);
+	if (spec == "itu")
+	{
+		if (const auto matrix = DownmixMatrix::itu_stereo(nb_channels))
+			return matrix;
+		throw std::invalid_argument{"--downmix itu: no stereo downmix for " + std::to_string(nb_channels) + " channels"};
+	}
+	return DownmixMatrix::parse(spec, nb_channels);
+}
+
+FfmpegCliMedia::PcmFormat Main::pcm_format() const
+{
+	return args.get<bool>("--pcm-s16") ? FfmpegCliMedia::PcmFormat::S16LE : FfmpegCliMedia::PcmFormat::F32LE;
+}
+
+void Main::use_spectrum_args(SS &ss, const float hue_offset)
+{
+	ss.set_multiplier(args.get<float>("-m"));
+	ss.set_bar_width(args.get<uint>("-bw"));
+	ss.set_bar_spacing(args.get<uint>("-bs"));
+
+	{ // spectrum coloring type
+		const auto &color_str = args.get("--color");
+		if (color_str == "wheel")
+		{
+			ss.set_color_mode(SD::ColorMode::WHEEL);
+			const auto &hsv = args.get<std::vector<float>>("--hsv");
+			assert(hsv.size() == 3);
+			ss.set_color_wheel_hsv({std::fmod(hsv[0] + hue_offset, 1.f), hsv[1], hsv[2]});
+			ss.set_color_wheel_rate(args.get<float>("--wheel-rate"));
+		}
+		else if (color_str == "solid")
+		{
+			ss.set_color_mode(SD::ColorMode::SOLID);
+			const auto &rgb = args.get<std::vector<uint8_t>>("--rgb");
+			ss.set_solid_color({rgb[0], rgb[1], rgb[2]});
+		}
+		else
+			throw std::invalid_argument{"--color: unknown coloring type: " + color_str};
+	}
+}
+
+void Main::use_analyzer_args()
+{
+	fa.set_fft_size(args.get<uint>("-n"));
+
+	{ // accumulation method
+		static const std::unordered_map<std::string, FA::AccumulationMethod> am_map{
+			{"sum", FA::AccumulationMethod::SUM},
+			{"max", FA::AccumulationMethod::MAX},
+		};
+
+		const auto &am_str = args.get("-a");
+
+		try
+		{
+			fa.set_accum_method(am_map.at(am_str));
+		}
+		catch (std::out_of_range)
+		{
+			throw std::invalid_argument{"--accum-method: unknown accumulation method: " + am_str};
+		}
+	}
+
+	{ // window function
+		static const std::unordered_map<std::string, FA::WindowFunction> wf_map{
+			{"hanning", FA::WindowFunction::HANNING},
+			{"hamming", FA::WindowFunction::HAMMING},
+			{"blackman", FA::WindowFunction::BLACKMAN},
+		};
+
+		const auto &wf_str = args.get("-w");
+
+		try
+		{
+			fa.set_window_func(wf_map.at(wf_str));
+		}
+		catch (std::out_of_range)
+		{
+			throw std::invalid_argument{"--window-func: unknown window function: " + wf_str};
+		}
+	}
+
+	{ // interpolation type
+		static const std::unordered_map<std::string, FA::InterpolationType> it_map{
+			{"none", FA::InterpolationType::NONE},
+			{"linear", FA::InterpolationType::LINEAR},
+			{"cspline", FA::InterpolationType::CSPLINE},
+			{"cspline_hermite", FA::InterpolationType::CSPLINE_HERMITE}};
+
+		const auto &it_str = args.get("-i");
+
+		try
+		{
+			fa.set_interp_type(it_map.at(it_str));
+		}
+		catch (std::out_of_range)
+		{
+			throw std::invalid_argument{"--interp-type: unknown interpolation type: " + it_str};
+		}
+	}
+
 	{ // -s, --scale
 		// clang-format off
 		static const std::unordered_map<std::string, FA::Scale> scale_map{
@@ -1,10 +1,15 @@
+#include <cmath>
 #include <iomanip>
 #include <iostream>
 
 #include "audioviz.hpp"
 #include "fx/Blur.hpp"
 #include "fx/Mult.hpp"
+#include "media/CaptureMedia.hpp"
 #include "media/FfmpegCliBoostMedia.hpp"
+#include "media/LiveMedia.hpp"
+#include "media/PlaylistMedia.hpp"
+#include "media/PrefetchMedia.hpp"
 
 #define capture_time(label, code)            \
 	{                                        \
@@ -13,26 +18,50 @@
 		capture_elapsed_time(label, _clock); \
 	}
 
+// how long a playlist's background and metadata take to fade over to the next track, in seconds
+static constexpr double track_crossfade = 1;
+
+// mono and common surround layouts are mixed to the stereo that the spectrum and particles need
+static std::unique_ptr<Media> downmixed_to_stereo(std::unique_ptr<Media> media)
+{
+	if (const auto matrix = DownmixMatrix::itu_stereo(media->nb_channels()))
+		media->set_downmix(*matrix);
+	return media;
+}
+
 audioviz::audioviz(
 	const sf::Vector2u size,
 	const std::string &media_url,
 	tt::FrequencyAnalyzer &fa,
 	viz::StereoSpectrum<BarType> &ss,
 	viz::ParticleSystem<ParticleShapeType> &ps,
+	const int antialiasing,
+	const MediaBackend backend)
+	: audioviz{size, downmixed_to_stereo(create_media(media_url, size, backend)), fa, ss, ps, antialiasing}
+{
+}
+
+audioviz::audioviz(
+	const sf::Vector2u size,
+	std::unique_ptr<Media> _media,
+	tt::FrequencyAnalyzer &fa,
+	viz::StereoSpectrum<BarType> &ss,
+	viz::ParticleSystem<ParticleShapeType> &ps,
 	const int antialiasing)
 	: size{size},
-	  media{new FfmpegCliBoostMedia{media_url, size}},
+	  antialiasing{antialiasing},
+	  media{std::move(_media)},
 	  fa{fa},
 	  ss{ss},
 	  scope{{{}, (sf::Vector2i)size}},
 	  ps{ps},
-	  final_rt{size, antialiasing},
-	  video_bg{size}
+	  final_rt{size, antialiasing}
 {
-	// for now only stereo is supported
-	// this will be moved into its own class eventually
-	if (media->astream().nb_channels() != 2)
-		throw std::runtime_error("only stereo audio is supported!");
+	// the stereo spectrum and particles analyze the first two channels of the audio
+	if (media->nb_channels() < 2)
+		throw std::runtime_error("audio must have at least two channels! mix it with --downmix");
+
+	analysis.add(fa, sa);
 
 	// default spectrum margin
 	// this sets the StereoSpectrum's rectangle (necessary for it to render)
@@ -57,13 +86,101 @@ audioviz::audioviz(
 	scope.set_shape_spacing(0);
 	scope.set_shape_width(2);
 	scope.set_fill_in(true);
-	left_channel.resize(scope.get_shape_count());
+}
+
+void audioviz::advance_video()
+{
+	if (video_eof)
+		return;
+
+	const auto read = [this](const std::span<uint8_t> pixels) { return media->read_video_frame(pixels); };
+	const auto now = (double)audio_frames_played / media->sample_rate();
+	const auto output_interval = 1. / framerate;
+	// frames are shown on the output frame closest to their time
+	const auto tolerance = output_interval / 2;
+	const auto interval = av_q2d(av_inv_q(media->video_frame_rate()));
+
+	if (!video_frames->front())
+	{ // nothing read yet
+		if (!video_frames->push(read))
+		{
+			video_eof = true;
+			return;
+		}
+		next_video_time = media->video_frame_time();
+	}
+
+	if (next_video_time > now + tolerance)
+	{
+		++video_dups;
+		return;
+	}
+
+	// the pushed frame is due, and pushing again makes it current. frames uploaded in its place would be shown
+	// on the next output frame, so skip the ones a later frame already supersedes by then, without uploading them
+	dropped_frame.resize(media->video_frame_bytes());
+	for (auto last_read = next_video_time; last_read + 2 * interval <= now + output_interval + tolerance;
+		 last_read = media->video_frame_time())
+	{
+		if (!media->read_video_frame(dropped_frame))
+			break;
+		++video_drops;
+	}
+
+	if (video_frames->push(read))
+		next_video_time = media->video_frame_time();
+	else
+		video_eof = true;
+}
+
+void audioviz::seek(const double seconds)
+{
+	const auto target = std::max(seconds, 0.);
+	for (const auto &stem : stems)
+		stem->seek(target);
+	media->seek(target);
+	audio_frames_played = std::llround(target * media->sample_rate());
+
+	// smoothed spectra and held peaks belong to the old position
+	sa.reset_smoother();
+	if (ps_sa)
+		ps_sa->reset_smoother();
+
+	// `advance_video` starts over as if nothing was read yet
+	if (video_frames)
+	{
+		video_frames->reset();
+		video_eof = false;
+	}
+}
+
+void audioviz::scrub(const double delta)
+{
+	auto target = std::max(position() + delta, 0.);
+	if (seek_index_ready)
+	{
+		const auto keyframe = (delta > 0) ? seek_index->at_or_after(target) : seek_index->at_or_before(target);
+		target = keyframe.value_or(target);
+	}
+	seek(target);
+}
+
+void audioviz::load_seek_index()
+{
+	if (seek_index_loader.joinable())
+		return;
+	seek_index_loader = std::jthread{
+		[this, url = media->url, video = video_frames.has_value()](const std::stop_token st)
+		{
+			seek_index.emplace(url, video, st);
+			seek_index_ready = true;
+		}};
 }
 
 void audioviz::perform_fft()
 {
 	ss.configure_analyzer(sa);
-	capture_time("fft", sa.analyze(fa, media->audio_buffer().data(), true));
+	capture_time("fft", analysis.analyze(media->audio_buffer().channels(), media->nb_channels()));
 }
 
 void audioviz::layers_init(const int antialiasing)
@@ -73,20 +190,28 @@ void audioviz::layers_init(const int antialiasing)
 
 		if (media->vstream()) // set_orig_cb() to draw video frames on the layer
 		{
-			// round the framerate bc sometimes it's 29.97
-			const int video_framerate = std::round(av_q2d(media->vstream()->get()->avg_frame_rate));
+			if (const auto format = media->video_format(); format != Media::VideoFormat::RGBA)
+			{
+				// swscale treats untagged video as bt.601 when converting to rgba, so do the same
+				const auto &codecpar = *media->vstream()->get()->codecpar;
+				yuv.emplace(
+					media->video_size,
+					format == Media::VideoFormat::NV12,
+					codecpar.color_space == AVCOL_SPC_BT709,
+					codecpar.color_range == AVCOL_RANGE_JPEG && codecpar.color_space != AVCOL_SPC_RGB);
+			}
+			video_frames.emplace(yuv ? yuv->texture_size() : media->video_size);
 			bg.set_orig_cb(
-				[this, frames_to_wait{framerate / video_framerate}](auto &orig_rt)
+				[this](auto &orig_rt)
 				{
-					if (vfcount < frames_to_wait)
-						++vfcount;
-					else
+					advance_video();
+					// a frame that is still current is drawn again, since effects are applied to it every frame
+					if (const auto frame = video_frames->front())
 					{
-						if (media->read_video_frame(video_bg))
-							orig_rt.draw(sf::Sprite{video_bg});
+						if (yuv)
+							yuv->draw(orig_rt, *frame);
 						else
-							std::cout << "media->read_video_frame returned false????????\n";
-						vfcount = 1; // ALWAYS RESET TO 1 OTHERWISE THE IF CHECK ABOVE DOESN'T MAKE SENSE
+							orig_rt.draw(sf::Sprite{*frame});
 					}
 					orig_rt.display();
 				});
@@ -100,7 +225,7 @@ void audioviz::layers_init(const int antialiasing)
 			if (media->attached_pic())
 			{
 				metadata.set_album_cover(*media->attached_pic(), {150, 150});
-				set_background(*media->attached_pic());
+				show_background(*media->attached_pic());
 			}
 
 			// don't set_fx_cb() if there is no video stream!
@@ -116,15 +241,17 @@ void audioviz::layers_init(const int antialiasing)
 				// on fft being performed on the current audio buffer for this frame
 				perform_fft();
 
+				const auto &ps_analyzer = ps_sa ? *ps_sa : sa;
+
 				// lock the tickrate of the particles at 60hz for non-60fps output
 
 				if (framerate < 60)
-					ps.update(sa, {.multiplier = 60.f / framerate});
+					ps.update(ps_analyzer, {.multiplier = 60.f / framerate});
 				else if (framerate == 60)
-					ps.update(sa);
+					ps.update(ps_analyzer);
 				else if (framerate > 60 && frame_count >= (framerate / 60.))
 				{
-					ps.update(sa);
+					ps.update(ps_analyzer);
 					frame_count = 0;
 				}
 
@@ -147,9 +274,7 @@ void audioviz::layers_init(const int antialiasing)
 		scope_layer.set_orig_cb(
 			[&](auto &orig_rt)
 			{
-				for (int i = 0; i < scope.get_shape_count(); ++i)
-					left_channel[i] = media->audio_buffer()[i * media->astream().nb_channels() + 0 /* left channel */];
-				scope.update_shape_positions(left_channel);
+				scope.update_shape_positions(media->audio_buffer().channel(0 /* left channel */));
 				orig_rt.clear(sf::Color::Transparent);
 				orig_rt.draw(scope);
 				orig_rt.display();
@@ -199,25 +324,27 @@ viz::Layer *audioviz::get_layer(const std::string &name)
 // need to do this outside of the constructor otherwise the texture is broken?
 void audioviz::use_attached_pic_as_bg()
 {
+	bg_follows_media = true;
 	if (media->attached_pic())
-		set_background(*media->attached_pic());
+		show_background(*media->attached_pic());
 }
 
 void audioviz::add_default_effects()
 {
 	if (const auto bg = get_layer("bg"))
 	{
-		// clang-format off
-		bg->effects.emplace_back(
-			media->vstream()
-				? new fx::Blur{2.5, 2.5, 5}
-				: new fx::Blur{7.5, 7.5, 15});
-		// clang-format on
 		if (!media->vstream())
+		{
+			bg->effects.emplace_back(new fx::Blur{7.5, 7.5, 15});
 			bg->effects.emplace_back(new fx::Mult{0.75});
+		}
+		// ffmpeg may already be applying them to every frame
+		else if (media->video_filter().empty())
+			for (auto &effect : default_video_bg_effects())
+				bg->effects.emplace_back(std::move(effect));
 		if (media->attached_pic())
 			// this will reapply the effects without any bs
-			set_background(*media->attached_pic());
+			show_background(*media->attached_pic());
 	}
 
 	if (const auto particles = get_layer("particles"))
@@ -225,11 +352,22 @@ void audioviz::add_default_effects()
 
 	if (const auto spectrum = get_layer("spectrum"))
 		spectrum->effects.emplace_back(new fx::Blur{1, 1, 20});
+
+	for (int i = 1; i <= (int)stems.size(); ++i)
+		if (const auto stem = get_layer("stem" + std::to_string(i)))
+			stem->effects.emplace_back(new fx::Blur{1, 1, 20});
+}
+
+std::vector<std::unique_ptr<fx::Effect>> audioviz::default_video_bg_effects()
+{
+	std::vector<std::unique_ptr<fx::Effect>> effects;
+	effects.emplace_back(new fx::Blur{2.5, 2.5, 5});
+	return effects;
 }
 
 const std::string audioviz::get_media_url() const
 {
-	return media->format()->url;
+	return media->url;
 }
 
 void audioviz::set_timing_text_enabled(const bool enabled)
@@ -239,6 +377,7 @@ void audioviz::set_timing_text_enabled(const bool enabled)
 
 void audioviz::set_album_cover(const std::string &image_path, const sf::Vector2f size)
 {
+	cover_follows_media = false;
 	metadata.set_album_cover(sf::Texture{image_path}, size);
 }
 
@@ -264,16 +403,27 @@ void audioviz::metadata_init()
 
 void audioviz::set_spectrum_margin(const int margin)
 {
+	spectrum_margin = margin;
 	ss.set_rect({{margin, margin}, {size.x - 2 * margin, size.y - 2 * margin}});
+	for (const auto &stem : stems)
+		stem->ss.set_rect({{margin, margin}, {size.x - 2 * margin, size.y - 2 * margin}});
 }
 
 void audioviz::set_framerate(const int framerate)
 {
 	this->framerate = framerate;
-	afpvf = media->astream().sample_rate() / framerate;
+	afpvf = media->sample_rate() / framerate;
+	for (const auto &stem : stems)
+		stem->set_framerate(framerate);
 }
 
 void audioviz::set_background(const sf::Texture &txr)
+{
+	bg_follows_media = false;
+	show_background(txr);
+}
+
+void audioviz::show_background(const sf::Texture &txr)
 {
 	const auto bg = get_layer("bg");
 	if (!bg)
@@ -288,7 +438,62 @@ void audioviz::set_background(const sf::Texture &txr)
 	bg->orig_display();
 	bg->apply_fx();
 
-	bg->set_fx_cb(viz::Layer::DRAW_FX_RT);
+	bg->set_fx_cb(
+		[this](auto &, auto &fx_rt, auto &target)
+		{
+			target.draw(fx_rt.sprite());
+			// the previous track's background, fading out over this one
+			if (bg_fading && fade > 0)
+			{
+				sf::Sprite spr{bg_fade_rt->getTexture()};
+				spr.setColor({255, 255, 255, (uint8_t)(255 * fade)});
+				target.draw(spr);
+			}
+		});
+}
+
+void audioviz::change_track(const size_t index)
+{
+	track = index;
+	fade_frame = 0;
+	fade_frames = std::max(1, (int)std::lround(framerate * track_crossfade));
+
+	// created on the first track change, so that single tracks don't pay for them
+	if (!metadata_rt)
+	{
+		metadata_fade_rt.emplace(size);
+		metadata_rt.emplace(size);
+	}
+
+	metadata_fade_rt->clear(sf::Color::Transparent);
+	metadata_fade_rt->draw(metadata);
+	metadata_fade_rt->display();
+
+	if (cover_follows_media)
+	{
+		if (const auto &pic = media->attached_pic())
+			metadata.set_album_cover(*pic, {150, 150});
+		else
+			metadata.clear_album_cover();
+	}
+	metadata.use_metadata(*media);
+
+	// it doesn't change while fading
+	metadata_rt->clear(sf::Color::Transparent);
+	metadata_rt->draw(metadata);
+	metadata_rt->display();
+
+	// a track without a picture keeps the previous background
+	bg_fading = false;
+	if (const auto bg = get_layer("bg"); bg && bg_follows_media && media->attached_pic())
+	{
+		if (!bg_fade_rt)
+			bg_fade_rt.emplace(size);
+		bg_fade_rt->clear();
+		bg_fade_rt->copy(bg->get_fx_rt());
+		bg_fading = true;
+		show_background(*media->attached_pic());
+	}
 }
 
 void audioviz::set_spectrum_blendmode(const sf::BlendMode &bm)
@@ -296,18 +501,23 @@ void audioviz::set_spectrum_blendmode(const sf::BlendMode &bm)
 	spectrum_bm = bm;
 }
 
-void audioviz::capture_elapsed_time(const std::string &label, const sf::Clock &_clock)
+void audioviz::capture_elapsed_time(const std::string_view label, const sf::Clock &_clock)
 {
-	tt_ss << std::setw(20) << std::left << label << _clock.getElapsedTime().asMicroseconds() / 1e3f << "ms\n";
+	const auto ms = _clock.getElapsedTime().asMicroseconds() / 1e3f;
+	stage_times.emplace_back(label, ms);
+	tt_ss << std::setw(20) << std::left << label << ms << "ms\n";
 }
 
 #ifdef AUDIOVIZ_PORTAUDIO
 void audioviz::set_audio_playback_enabled(const bool enabled)
 {
-	if (enabled)
+	// live input is already audible; playing it again would echo it late, and pace rendering by a second clock
+	if (enabled && !dynamic_cast<const LiveMedia *>(media.get()))
 	{
 		pa_init.emplace();
-		pa_stream.emplace(0, 2, paFloat32, media->astream().sample_rate(), afpvf);
+		// non-interleaved, so that the planar audio buffer can be played without interleaving it again
+		pa_stream.emplace(
+			0, media->nb_channels(), paFloat32 | paNonInterleaved, media->sample_rate(), afpvf);
 		pa_stream->start();
 	}
 	else
@@ -321,7 +531,7 @@ void audioviz::play_audio()
 {
 	try // to play the audio
 	{
-		pa_stream->write(media->audio_buffer().data(), afpvf);
+		pa_stream->write(media->audio_buffer().channels(), afpvf);
 	}
 	catch (const pa::Error &e)
 	{
@@ -335,8 +545,22 @@ void audioviz::play_audio()
 bool audioviz::prepare_frame()
 {
 	assert(media);
+	stage_times.clear();
+
+	// stems decode and analyze on their own threads while the main media is handled here
+	for (const auto &stem : stems)
+		stem->begin_frame();
+
+	// stem layers wait for their stem, but make sure no worker is left running when we return
+	const auto finish_stems = [&]
+	{
+		for (const auto &stem : stems)
+			stem->finish_frame();
+	};
+
 	// now that two things are dependent on different amounts of audio, decode as much as needed
-	capture_time("media_decode", media->decode_audio(std::max(fft_size, (int)scope.get_shape_count())));
+	const auto fft_frames = analysis.required_frames();
+	capture_time("media_decode", media->decode_audio(std::max(fft_frames, (int)scope.get_shape_count())));
 
 #ifdef AUDIOVIZ_PORTAUDIO
 	if (pa_stream)
@@ -344,16 +568,51 @@ bool audioviz::prepare_frame()
 #endif
 
 	// we don't have enough samples for fft; end here
-	if ((int)media->audio_buffer().size() < 2 * fft_size)
+	if (media->audio_buffer().frames() < fft_frames)
+	{
+		finish_stems();
 		return false;
+	}
+
+	const auto playlist = dynamic_cast<const PlaylistMedia *>(media.get());
+	if (playlist && playlist->track() != track)
+		capture_time("change_track", change_track(playlist->track()));
+	fade = (fade_frame < fade_frames) ? 1 - (float)fade_frame++ / fade_frames : 0;
 
 	final_rt.clear();
 	for (auto &layer : layers)
 		capture_time(layer.get_name(), layer.full_lifecycle(final_rt));
 	final_rt.display();
+	finish_stems();
 
 	// THE IMPORTANT PART
+	// how far behind the input this frame is; overruns mean blocks were dropped because we were too slow
+	if (const auto live = dynamic_cast<const LiveMedia *>(media.get()))
+	{
+		tt_ss << std::setw(20) << std::left << "live latency" << live->latency() * 1e3 << "ms";
+#ifdef AUDIOVIZ_PORTAUDIO
+		if (const auto capture = dynamic_cast<const CaptureMedia *>(live))
+			tt_ss << " (device " << capture->device_latency() * 1e3 << "ms)";
+#endif
+		tt_ss << " queued " << live->queued_blocks() << '/' << LiveMedia::queue_blocks << " overruns "
+			  << live->overruns() << '\n';
+	}
+
 	capture_time("audio_buffer_erase", media->audio_buffer_erase(afpvf));
+	audio_frames_played += afpvf;
+
+	if (playlist)
+		tt_ss << std::setw(20) << std::left << "track" << track + 1 << '/' << playlist->urls.size() << '\n';
+
+	if (video_frames)
+		tt_ss << std::setw(20) << std::left << "video" << "time " << media->video_frame_time() << "s dups "
+			  << video_dups << " drops " << video_drops << '\n';
+
+	// how far ahead background decoding is; underruns mean it can't keep up
+	if (const auto prefetch = dynamic_cast<const PrefetchMedia *>(media.get()))
+		tt_ss << std::setw(20) << std::left << "prefetch" << "audio " << prefetch->audio_queue_size() << '/'
+			  << prefetch->audio_queue_capacity() << " video " << prefetch->video_queue_size() << '/'
+			  << prefetch->video_queue_capacity() << " underruns " << prefetch->underruns() << '\n';
 
 	timing_text.setString(tt_ss.str());
 	tt_ss.str("");
@@ -364,13 +623,190 @@ bool audioviz::prepare_frame()
 void audioviz::draw(sf::RenderTarget &target, const sf::RenderStates states) const
 {
 	target.draw(final_rt.sprite(), states);
-	target.draw(metadata, states);
+	if (fade > 0)
+	{
+		// text drawn onto a transparent texture comes out premultiplied, so scaling all four channels fades it
+		auto premultiplied = states;
+		premultiplied.blendMode = {sf::BlendMode::Factor::One, sf::BlendMode::Factor::OneMinusSrcAlpha};
+		const auto out = (uint8_t)(255 * fade), in = (uint8_t)(255 - out);
+		sf::Sprite old_spr{metadata_fade_rt->getTexture()}, new_spr{metadata_rt->getTexture()};
+		old_spr.setColor({out, out, out, out});
+		new_spr.setColor({in, in, in, in});
+		target.draw(old_spr, premultiplied);
+		target.draw(new_spr, premultiplied);
+	}
+	else
+		target.draw(metadata, states);
 	if (tt_enabled)
 		target.draw(timing_text, states);
 }
 
 void audioviz::set_fft_size(const int n)
 {
-	fft_size = n;
 	fa.set_fft_size(n);
 }
+
+void audioviz::set_particle_analyzer(tt::FrequencyAnalyzer &fa, const int spectrum_size)
+{
+	if (ps_sa)
+		throw std::logic_error("particle analyzer already set!");
+	ps_sa.emplace().resize(spectrum_size);
+	analysis.add(fa, *ps_sa);
+}
+
+void audioviz::set_spectrum_smoother(const tt::SpectrumSmoother &smoother)
+{
+	spectrum_smoother = smoother;
+	sa.set_smoother(smoother);
+	for (const auto &stem : stems)
+		stem->sa.set_smoother(smoother);
+}
+
+void audioviz::set_particle_smoother(const tt::SpectrumSmoother &smoother)
+{
+	if (!ps_sa)
+		throw std::logic_error("set_particle_smoother: no particle analyzer set!");
+	ps_sa->set_smoother(smoother);
+}
+
+void audioviz::add_stem(
+	const std::string &url,
+	tt::FrequencyAnalyzer &fa,
+	viz::StereoSpectrum<BarType> &ss,
+	viz::ParticleSystem<ParticleShapeType> *const ps)
+{
+	auto &stem = *stems.emplace_back(new Stem{url, fa, ss, ps, framerate});
+	if (spectrum_smoother)
+		stem.sa.set_smoother(*spectrum_smoother);
+
+	// same placement and mirroring as the main spectrum
+	ss.set_left_backwards(true);
+	ss.set_rect({
+		{spectrum_margin, spectrum_margin},
+		{size.x - 2 * spectrum_margin, size.y - 2 * spectrum_margin},
+	});
+
+	auto &layer = add_layer("stem" + std::to_string(stems.size()), antialiasing);
+	layer.set_orig_cb(
+		[this, &stem](auto &orig_rt)
+		{
+			stem.finish_frame();
+			stem.ss.update(stem.sa);
+			orig_rt.clear(sf::Color::Transparent);
+			if (stem.ps)
+			{
+				// particles move at their 60hz speed regardless of framerate
+				stem.ps->update(stem.sa, {.multiplier = 60.f / framerate});
+				orig_rt.draw(*stem.ps);
+			}
+			orig_rt.draw(stem.ss);
+			orig_rt.display();
+		});
+	layer.set_fx_cb(
+		[&stem](auto &, auto &fx_rt, auto &target)
+		{
+			target.draw(fx_rt.sprite(), sf::BlendAdd);
+			if (stem.ps)
+				target.draw(*stem.ps, sf::BlendAdd);
+			// see the spectrum layer: redraw instead of blending to avoid dark bar edges
+			target.draw(stem.ss);
+		});
+}
+
+audioviz::Stem::Stem(
+	const std::string &url,
+	tt::FrequencyAnalyzer &fa,
+	viz::StereoSpectrum<BarType> &ss,
+	viz::ParticleSystem<ParticleShapeType> *const ps,
+	const int framerate)
+	: ss{ss},
+	  ps{ps},
+	  media{downmixed_to_stereo(std::make_unique<FfmpegCliBoostMedia>(url))},
+	  afpvf{media->sample_rate() / framerate}
+{
+	if (media->nb_channels() < 2)
+		throw std::runtime_error("stem audio must have at least two channels: " + url);
+	analysis.add(fa, sa);
+
+	worker = std::jthread{
+		[this](const std::stop_token st)
+		{
+			while (true)
+			{
+				work_ready.acquire();
+				if (st.stop_requested())
+					return;
+				try
+				{
+					work();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				work_done.release();
+			}
+		}};
+}
+
+audioviz::Stem::~Stem()
+{
+	// don't rethrow here like `finish_frame` does
+	if (pending)
+		work_done.acquire();
+	worker.request_stop();
+	work_ready.release();
+}
+
+void audioviz::Stem::set_framerate(const int framerate)
+{
+	finish_frame();
+	afpvf = media->sample_rate() / framerate;
+}
+
+void audioviz::Stem::seek(const double seconds)
+{
+	finish_frame();
+	media->seek(seconds);
+	// the audio buffer starts fresh, so there is nothing to advance past
+	started = false;
+	sa.reset_smoother();
+}
+
+void audioviz::Stem::begin_frame()
+{
+	// resizing `sa` must not race with the worker
+	ss.configure_analyzer(sa);
+	pending = true;
+	work_ready.release();
+}
+
+void audioviz::Stem::finish_frame()
+{
+	if (!pending)
+		return;
+	work_done.acquire();
+	pending = false;
+	if (error)
+		std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void audioviz::Stem::work()
+{
+	// advance by one video frame, like the main media does at the end of `prepare_frame`
+	if (started)
+		media->audio_buffer_erase(afpvf);
+	started = true;
+
+	const auto fft_frames = analysis.required_frames();
+	media->decode_audio(fft_frames);
+
+	// a stem shorter than the main media just goes quiet
+	if (media->audio_buffer().frames() < fft_frames)
+	{
+		sa.clear();
+		return;
+	}
+
+	analysis.analyze(media->audio_buffer().channels(), media->nb_channels());
+}
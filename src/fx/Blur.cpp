@@ -1,5 +1,7 @@
 #include "fx/Blur.hpp"
 
+#include <cmath>
+
 namespace fx
 {
 
@@ -28,4 +30,12 @@ void Blur::apply(tt::RenderTexture &rt) const
 	}
 }
 
+std::optional<std::string> Blur::ffmpeg_filter() const
+{
+	// the shader's 9-tap kernel has a standard deviation of ~1.69 taps, and its taps are `rad` pixels apart.
+	// every pass convolves with it again, so the variances add up
+	const auto sigma = [&](const float rad) { return 1.69f * rad * std::sqrt((float)n_passes); };
+	return "gblur=sigma=" + std::to_string(sigma(hrad)) + ":sigmaV=" + std::to_string(sigma(vrad));
+}
+
 } // namespace fx
@@ -0,0 +1,21 @@
+#include "fx/Effect.hpp"
+
+namespace fx
+{
+
+std::optional<std::string> Effect::ffmpeg_filters(const std::vector<std::unique_ptr<Effect>> &effects)
+{
+	std::string chain;
+	for (const auto &effect : effects)
+	{
+		const auto filter = effect->ffmpeg_filter();
+		if (!filter)
+			return {};
+		if (!chain.empty())
+			chain += ',';
+		chain += *filter;
+	}
+	return chain;
+}
+
+} // namespace fx
@@ -15,4 +15,10 @@ void Mult::apply(tt::RenderTexture &rt) const
 	rt.display();
 }
 
+std::optional<std::string> Mult::ffmpeg_filter() const
+{
+	const auto f = std::to_string(factor);
+	return "colorchannelmixer=rr=" + f + ":gg=" + f + ":bb=" + f;
+}
+
 } // namespace fx
@@ -0,0 +1,206 @@
+#include "media/AudioRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+AudioRing::AudioRing(const int num_channels, const int capacity)
+	: _num_channels{num_channels},
+	  read_ptrs(num_channels)
+{
+	if (num_channels <= 0)
+		throw std::invalid_argument("AudioRing: num_channels <= 0");
+	allocate(capacity);
+	update_read_ptrs();
+}
+
+AudioRing::~AudioRing()
+{
+	release();
+}
+
+void AudioRing::allocate(int capacity)
+{
+	base = nullptr;
+	double_mapped = false;
+
+#ifdef LINUX
+	// mappings have page granularity, so round the capacity up to whole pages
+	const auto page_floats = sysconf(_SC_PAGESIZE) / sizeof(float);
+	capacity = (capacity + page_floats - 1) / page_floats * page_floats;
+	const auto bytes = capacity * sizeof(float);
+
+	// one region of `2 * bytes` per channel; both halves map the channel's part of the memfd.
+	// if any step fails, fall back to the plain allocation below.
+	if (const auto fd = memfd_create("audioviz-audio-ring", MFD_CLOEXEC); fd != -1)
+	{
+		void *region = MAP_FAILED;
+		if (!ftruncate(fd, bytes * _num_channels))
+			region = mmap(nullptr, 2 * bytes * _num_channels, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (region != MAP_FAILED)
+		{
+			const auto start = static_cast<char *>(region);
+			bool ok = true;
+			for (int c = 0; ok && c < _num_channels; ++c)
+				for (int half = 0; ok && half < 2; ++half)
+					ok = mmap(
+							 start + (2 * c + half) * bytes,
+							 bytes,
+							 PROT_READ | PROT_WRITE,
+							 MAP_SHARED | MAP_FIXED,
+							 fd,
+							 c * bytes) != MAP_FAILED;
+			if (ok)
+			{
+				base = reinterpret_cast<float *>(start);
+				double_mapped = true;
+			}
+			else
+				munmap(region, 2 * bytes * _num_channels);
+		}
+
+		// the mappings keep the memory alive
+		close(fd);
+	}
+#endif
+
+	if (!base)
+		base = new float[2 * (size_t)capacity * _num_channels];
+
+	_capacity = capacity;
+}
+
+void AudioRing::release()
+{
+	if (!base)
+		return;
+#ifdef LINUX
+	if (double_mapped)
+		munmap(base, 2 * (size_t)_capacity * sizeof(float) * _num_channels);
+	else
+#endif
+		delete[] base;
+	base = nullptr;
+}
+
+void AudioRing::reserve(const int frames)
+{
+	if (frames <= _capacity)
+		return;
+
+	// move the buffered frames into a bigger ring
+	const auto old_capacity = _capacity;
+	const auto buffered = this->frames();
+
+	std::vector<float> saved((size_t)buffered * _num_channels);
+	for (int c = 0; c < _num_channels; ++c)
+		std::ranges::copy(channel(c), saved.begin() + (size_t)c * buffered);
+
+	// at least double, so that growing in small steps doesn't copy over and over
+	release();
+	allocate(std::max(frames, 2 * old_capacity));
+
+	read_pos = write_pos = 0;
+	std::vector<const float *> planes(_num_channels);
+	for (int c = 0; c < _num_channels; ++c)
+		planes[c] = saved.data() + (size_t)c * buffered;
+	write(planes.data(), buffered);
+}
+
+void AudioRing::write(const float *const interleaved, const int frames)
+{
+	if (frames <= 0)
+		return;
+	reserve(this->frames() + frames);
+
+	const auto w = write_pos % _capacity;
+	for (int c = 0; c < _num_channels; ++c)
+	{
+		const auto ring = channel_base(c);
+		if (double_mapped)
+			// writing past the end of the ring lands in the mirror, which is the start of the ring
+			for (int i = 0; i < frames; ++i)
+				ring[w + i] = interleaved[i * _num_channels + c];
+		else
+			for (int i = 0; i < frames; ++i)
+			{
+				const auto j = (w + i) % _capacity;
+				ring[j] = ring[j + _capacity] = interleaved[i * _num_channels + c];
+			}
+	}
+
+	write_pos += frames;
+	update_read_ptrs();
+}
+
+void AudioRing::write(const float *const *const planes, const int frames)
+{
+	if (frames <= 0)
+		return;
+	reserve(this->frames() + frames);
+
+	const auto w = write_pos % _capacity;
+	for (int c = 0; c < _num_channels; ++c)
+	{
+		const auto ring = channel_base(c);
+		if (double_mapped)
+			std::memcpy(ring + w, planes[c], frames * sizeof(float));
+		else
+		{
+			// copy in up to two pieces, once into each copy of the ring
+			const auto first = std::min<int>(frames, _capacity - w);
+			for (const auto offset : {0, _capacity})
+			{
+				std::memcpy(ring + offset + w, planes[c], first * sizeof(float));
+				std::memcpy(ring + offset, planes[c] + first, (frames - first) * sizeof(float));
+			}
+		}
+	}
+
+	write_pos += frames;
+	update_read_ptrs();
+}
+
+void AudioRing::consume(const int frames)
+{
+	read_pos += std::clamp(frames, 0, this->frames());
+	update_read_ptrs();
+}
+
+void AudioRing::clear()
+{
+	read_pos = write_pos;
+	update_read_ptrs();
+}
+
+void AudioRing::set_num_channels(const int num_channels)
+{
+	if (num_channels <= 0)
+		throw std::invalid_argument("AudioRing: num_channels <= 0");
+	release();
+	_num_channels = num_channels;
+	read_ptrs.resize(num_channels);
+	read_pos = write_pos = 0;
+	allocate(_capacity);
+	update_read_ptrs();
+}
+
+std::span<const float> AudioRing::channel(const int channel) const
+{
+	if (channel < 0 || channel >= _num_channels)
+		throw std::invalid_argument("AudioRing::channel: channel index out of bounds!");
+	return {read_ptrs[channel], (size_t)frames()};
+}
+
+void AudioRing::update_read_ptrs()
+{
+	const auto r = read_pos % _capacity;
+	for (int c = 0; c < _num_channels; ++c)
+		read_ptrs[c] = channel_base(c) + r;
+}
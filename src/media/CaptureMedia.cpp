@@ -0,0 +1,113 @@
+#ifdef AUDIOVIZ_PORTAUDIO
+
+#include "media/CaptureMedia.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+static void check(const PaError err, const char *const what)
+{
+	if (err != paNoError)
+		throw std::runtime_error{std::string{"CaptureMedia: "} + what + ": " + Pa_GetErrorText(err)};
+}
+
+CaptureMedia::Device
+CaptureMedia::find_device(const std::string &device, const int sample_rate, const int nb_channels)
+{
+	// portaudio counts initializations, so this doesn't get in the way of the member
+	pa::PortAudio _;
+
+	const auto index = (device == "default") ? Pa_GetDefaultInputDevice() : std::stoi(device);
+	const auto info = (index >= 0 && index < Pa_GetDeviceCount()) ? Pa_GetDeviceInfo(index) : nullptr;
+	if (!info || info->maxInputChannels <= 0)
+	{
+		std::ostringstream ss;
+		ss << "CaptureMedia: no input device '" << device << "'; input devices:\n";
+		list_devices(ss);
+		throw std::runtime_error{ss.str()};
+	}
+
+	return {
+		index,
+		sample_rate ? sample_rate : (int)info->defaultSampleRate,
+		nb_channels ? nb_channels : std::min(2, info->maxInputChannels),
+		info->defaultLowInputLatency,
+		info->name,
+	};
+}
+
+CaptureMedia::CaptureMedia(const std::string &device, const int sample_rate, const int nb_channels, const int block_frames)
+	: CaptureMedia{find_device(device, sample_rate, nb_channels), block_frames}
+{
+}
+
+CaptureMedia::CaptureMedia(const Device &device, const int block_frames)
+	: LiveMedia{"pa:" + device.name, device.sample_rate, device.nb_channels, block_frames},
+	  _device_latency{[&]
+					  {
+						  // interleaved, so that a whole buffer is one copy into a block
+						  const PaStreamParameters params{
+							  device.index, device.nb_channels, paFloat32, device.latency, nullptr};
+						  check(
+							  Pa_OpenStream(
+								  &stream, &params, nullptr, device.sample_rate, block_frames, paNoFlag, callback, this),
+							  "Pa_OpenStream");
+						  return Pa_GetStreamInfo(stream)->inputLatency;
+					  }()}
+{
+	if (const auto err = Pa_StartStream(stream); err != paNoError)
+	{
+		Pa_CloseStream(stream);
+		check(err, "Pa_StartStream");
+	}
+}
+
+CaptureMedia::~CaptureMedia()
+{
+	// stops the callback before the queue goes away
+	Pa_CloseStream(stream);
+	_eof = true;
+	signal_progress();
+}
+
+int CaptureMedia::callback(
+	const void *const input,
+	void *,
+	const unsigned long frames,
+	const PaStreamCallbackTimeInfo *const time,
+	const PaStreamCallbackFlags flags,
+	void *const user_data)
+{
+	auto &self = *static_cast<CaptureMedia *>(user_data);
+	const auto block = self._blocks.back();
+	if (!block || (flags & paInputOverflow))
+		++self._overruns;
+	if (!block || !input)
+		return paContinue;
+
+	const auto n = std::min<unsigned long>(frames, self.block_frames);
+	std::memcpy(block->samples.data(), input, n * self._nb_channels * sizeof(float));
+	block->frames = n;
+
+	// the adc time is on the stream's clock; only the difference to its current time carries over
+	block->captured = Clock::now() - std::chrono::duration_cast<Clock::duration>(
+										 std::chrono::duration<double>(time->currentTime - time->inputBufferAdcTime));
+	self._blocks.push();
+	self.signal_progress();
+	return paContinue;
+}
+
+void CaptureMedia::list_devices(std::ostream &os)
+{
+	pa::PortAudio _;
+	const auto default_input = Pa_GetDefaultInputDevice();
+	for (PaDeviceIndex i = 0; i < Pa_GetDeviceCount(); ++i)
+		if (const auto info = Pa_GetDeviceInfo(i); info->maxInputChannels > 0)
+			os << i << ": " << info->name << " (" << info->maxInputChannels << " channels, "
+			   << info->defaultSampleRate << " Hz)" << (i == default_input ? " [default]" : "") << '\n';
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "media/DownmixMatrix.hpp"
+
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+DownmixMatrix::DownmixMatrix(const int in_channels, const int out_channels, std::vector<float> coefficients)
+	: _in_channels{in_channels},
+	  _out_channels{out_channels},
+	  coefficients{std::move(coefficients)}
+{
+	if (in_channels <= 0 || out_channels <= 0)
+		throw std::invalid_argument{"DownmixMatrix: channel counts must be positive"};
+	if (this->coefficients.size() != (size_t)in_channels * out_channels)
+		throw std::invalid_argument{"DownmixMatrix: expected in_channels * out_channels coefficients"};
+}
+
+std::optional<DownmixMatrix> DownmixMatrix::itu_stereo(const int in_channels)
+{
+	constexpr float c = 0.70710678f; // -3 dB
+	std::vector<float> m;
+	switch (in_channels)
+	{
+	case 1:
+		m = {1, 1};
+		break;
+	case 6:
+		// FL FR FC LFE SL SR
+		m = {1, 0, c, 0, c, 0, 0, 1, c, 0, 0, c};
+		break;
+	case 8:
+		// FL FR FC LFE BL BR SL SR
+		m = {1, 0, c, 0, c, 0, c, 0, 0, 1, c, 0, 0, c, 0, c};
+		break;
+	default:
+		return {};
+	}
+
+	for (int row = 0; row < 2; ++row)
+	{
+		const auto begin = m.begin() + row * in_channels, end = begin + in_channels;
+		const auto sum = std::accumulate(begin, end, 0.f);
+		for (auto it = begin; it != end; ++it)
+			*it /= sum;
+	}
+	return DownmixMatrix{in_channels, 2, std::move(m)};
+}
+
+DownmixMatrix DownmixMatrix::parse(const std::string &spec, const int in_channels)
+{
+	std::vector<float> m;
+	int rows = 0;
+	std::istringstream rows_ss{spec};
+	for (std::string row; std::getline(rows_ss, row, ';'); ++rows)
+	{
+		std::istringstream row_ss{row};
+		int count = 0;
+		for (std::string value; std::getline(row_ss, value, ','); ++count)
+			try
+			{
+				m.push_back(std::stof(value));
+			}
+			catch (const std::logic_error &)
+			{
+				throw std::invalid_argument{"--downmix: not a number: '" + value + "'"};
+			}
+		if (count != in_channels)
+			throw std::invalid_argument{
+				"--downmix: output channel " + std::to_string(rows) + " has " + std::to_string(count) +
+				" coefficients, but the audio has " + std::to_string(in_channels) + " channels"};
+	}
+	if (!rows)
+		throw std::invalid_argument{"--downmix: empty matrix"};
+	return DownmixMatrix{in_channels, rows, std::move(m)};
+}
+
+// a compile-time stride turns the strided loads into shuffles, so these loops vectorize; see CMakeLists.txt
+template <int N>
+static void mix_interleaved(
+	const float *const __restrict in, const int frames, const float *const coefs, float *const __restrict out)
+{
+	for (int i = 0; i < frames; ++i)
+	{
+		float sum = 0;
+		for (int k = 0; k < N; ++k)
+			sum += coefs[k] * in[i * N + k];
+		out[i] = sum;
+	}
+}
+
+static void mix_interleaved(
+	const float *const __restrict in,
+	const int frames,
+	const int n,
+	const float *const coefs,
+	float *const __restrict out)
+{
+	for (int i = 0; i < frames; ++i)
+		out[i] = 0;
+	for (int k = 0; k < n; ++k)
+		if (const auto coef = coefs[k])
+			for (int i = 0; i < frames; ++i)
+				out[i] += coef * in[i * n + k];
+}
+
+void DownmixMatrix::apply(const float *const interleaved, const int frames, float *const *const out) const
+{
+	for (int o = 0; o < _out_channels; ++o)
+	{
+		const auto coefs = coefficients.data() + o * _in_channels;
+		switch (_in_channels)
+		{
+		case 1:
+			mix_interleaved<1>(interleaved, frames, coefs, out[o]);
+			break;
+		case 2:
+			mix_interleaved<2>(interleaved, frames, coefs, out[o]);
+			break;
+		case 6:
+			mix_interleaved<6>(interleaved, frames, coefs, out[o]);
+			break;
+		case 8:
+			mix_interleaved<8>(interleaved, frames, coefs, out[o]);
+			break;
+		default:
+			mix_interleaved(interleaved, frames, _in_channels, coefs, out[o]);
+		}
+	}
+}
+
+void DownmixMatrix::apply(const float *const *const planes, const int frames, float *const *const out) const
+{
+	for (int o = 0; o < _out_channels; ++o)
+	{
+		float *const __restrict dst = out[o];
+		for (int i = 0; i < frames; ++i)
+			dst[i] = 0;
+		for (int k = 0; k < _in_channels; ++k)
+			if (const auto coef = coefficient(o, k))
+			{
+				const float *const __restrict src = planes[k];
+				for (int i = 0; i < frames; ++i)
+					dst[i] += coef * src[i];
+			}
+	}
+}
@@ -1,24 +1,42 @@
 #include "media/FfmpegCliBoostMedia.hpp"
+#include "media/VideoScalePath.hpp"
 #include <iostream>
 
-FfmpegCliBoostMedia::FfmpegCliBoostMedia(const std::string &url, const sf::Vector2u video_size)
-	: FfmpegCliMedia{url, video_size},
-	  video_buffer(4 * video_size.x * video_size.y)
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static void print_args(const char *const label, const std::vector<std::string> &args)
+{
+	std::cout << label << " args: ";
+	for (const auto &arg : args)
+		std::cout << '\'' << arg << "' ";
+	std::cout << '\n';
+}
+
+FfmpegCliBoostMedia::FfmpegCliBoostMedia(
+	const Source &source, const sf::Vector2u video_size, const PcmFormat pcm_format,
+	const int max_video_fps,
+	const std::string &video_filter,
+	const bool yuv_video,
+	const int sample_rate)
+	: FfmpegCliMedia{source, video_size, pcm_format, sample_rate}
 {
 	{ // read attached pic
-		const auto &streams = _format.streams();
+		const auto &streams = _reader->streams();
 		if (const auto itr = std::ranges::find_if(
 				streams, [](const auto &s) { return s->disposition & AV_DISPOSITION_ATTACHED_PIC; });
 			itr != streams.cend())
 		{
 			const auto &stream = *itr;
-			_attached_pic = {stream->attached_pic.data, stream->attached_pic.size};
+			_attached_pic_data = {stream->attached_pic.data, (size_t)stream->attached_pic.size};
 		}
 	}
 
 	try // find video stream
 	{
-		const auto stream = _format.find_best_stream(AVMEDIA_TYPE_VIDEO);
+		const auto stream = _reader->find_best_stream(AVMEDIA_TYPE_VIDEO);
 		// we don't want to re-decode the attached pic stream
 		if (!(stream->disposition & AV_DISPOSITION_ATTACHED_PIC))
 			_vstream = stream;
@@ -28,81 +46,148 @@ FfmpegCliBoostMedia::FfmpegCliBoostMedia(const std::string &url, const sf::Vecto
 		std::cerr << e.what() << '\n';
 	}
 
-	{ // create audio decoder
-		std::vector<std::string> args{"-v", "warning", "-hwaccel", "auto"};
-		if (url.contains("http"))
-			args.insert(args.end(), {"-reconnect", "1"});
-		args.insert(args.end(), {"-i", url, "-c:a", "pcm_f32le", "-f", "f32le", "-"});
-		std::cout << "audio args: ";
-		for (const auto &arg : args)
-			std::cout << '\'' << arg << "' ";
-		std::cout << '\n';
-		audioc = bp::child{bp::search_path("ffmpeg"), args, bp::std_out > audio};
+	with_video = _vstream && video_size.x && video_size.y;
+	if (with_video)
+	{
+		_video_frame_rate = capped_video_rate(max_video_fps);
+		_video_filter = video_filter;
 	}
 
-	if (_vstream && video_size.x && video_size.y)
-	{ // create video decoder
-		std::vector<std::string> args{"-v", "warning", "-hwaccel", "auto"};
-		if (url.contains("http"))
-			args.insert(args.end(), {"-reconnect", "1"});
-		args.insert(args.end(), {"-i", url});
+	input_args = {"-v", "warning", "-hwaccel", "auto"};
+	if (url.contains("http"))
+		input_args.insert(input_args.end(), {"-reconnect", "1"});
+	const auto hint_args = probe_hint_args();
+	input_args.insert(input_args.end(), hint_args.begin(), hint_args.end());
 
-		// this needs more work!!!!!!!!!!
-		// need to determine whether vaapi works on the system before using vaapi
-		// also change quoting for windows
+	audio_args = {"-map", audio_map(), "-vn", "-c:a", std::string{"pcm_"} + pcm_format_name(), "-f", pcm_format_name()};
+	const auto ar_args = resample_args();
+	audio_args.insert(audio_args.end(), ar_args.begin(), ar_args.end());
+	video_args = {"-an"};
 
-#ifdef LINUX
-		// clang-format off
-		args.insert(args.end(), {
-			// really should not hardcode this!!!!!!!!!!!!!!!!
-			"-vaapi_device", "/dev/dri/renderD129",
-
-			// va-api hardware accelerated scaling!
-			"-vf", "format=nv12,hwupload,scale_vaapi=" + std::to_string(video_size.x) + ':' + std::to_string(video_size.y) + ",hwdownload"
-		});
-		// clang-format on
-#else
-		args.insert(args.end(), {"-s", std::to_string(video_size.x) + "x" + std::to_string(video_size.y)});
-#endif
+	if (with_video)
+	{
+		const auto &scale_path = VideoScalePath::best();
+		choose_video_format(yuv_video, scale_path);
+		video_args.insert(video_args.end(), {"-map", video_map()});
+		const auto scale_args = scale_path.args(video_size, fps_filter(), _video_filter);
+		video_args.insert(video_args.end(), scale_args.begin(), scale_args.end());
+		video_args.insert(video_args.end(), {"-pix_fmt", pix_fmt_name(), "-f", "rawvideo", "-"});
+	}
+
+	spawn(0);
+}
+
+void FfmpegCliBoostMedia::spawn(const double start)
+{
+	// the seek position is an input option, so it goes right before the input
+	auto input = input_args;
+	const auto seek_args = start_args(start);
+	input.insert(input.end(), seek_args.begin(), seek_args.end());
+	input.insert(input.end(), {"-i", url});
 
-		args.insert(args.end(), {"-pix_fmt", "rgba", "-f", "rawvideo", "-"});
+#ifndef _WIN32
+	if (with_video)
+	{ // one process for both streams: audio goes to an inherited pipe, video to stdout
+		// only the write end may be inherited, otherwise ffmpeg would keep our read end open
+		fcntl(audio.native_source(), F_SETFD, FD_CLOEXEC);
 
-		std::cout << "video args: ";
-		for (const auto &arg : args)
-			std::cout << '\'' << arg << "' ";
-		std::cout << '\n';
+		auto args = input;
+		args.insert(args.end(), audio_args.begin(), audio_args.end());
+		args.emplace_back("pipe:" + std::to_string(audio.native_sink()));
+		args.insert(args.end(), video_args.begin(), video_args.end());
+		print_args("ffmpeg", args);
+		ffmpeg = bp::child{bp::search_path("ffmpeg"), args, bp::std_out > video};
 
-		videoc = bp::child{bp::search_path("ffmpeg"), args, bp::std_out > video};
+		// ffmpeg has its copy of the write end now; ours would prevent eof
+		::close(audio.native_sink());
+		audio.assign_sink(-1);
+
+		// ffmpeg interleaves both streams, so audio never gets far ahead of video: a few seconds is plenty
+		audio_pump.emplace(
+			audio.native_source(), 4 * _sample_rate * _nb_channels * pcm_sample_size());
+		// a few frames: we read video by timestamp, so it never falls far behind the audio
+		video_pump.emplace(video.native_source(), 4 * video_frame_bytes());
 	}
+	else
+#endif
+	{ // create audio decoder
+		auto args = input;
+		args.insert(args.end(), audio_args.begin(), audio_args.end());
+		args.emplace_back("-");
+		print_args("audio", args);
+		ffmpeg = bp::child{bp::search_path("ffmpeg"), args, bp::std_out > audio};
+
+#ifdef _WIN32
+		// no way to hand ffmpeg a second pipe here, so video gets its own process
+		if (with_video)
+		{ // create video decoder
+			args = input;
+			args.insert(args.end(), video_args.begin(), video_args.end());
+			print_args("video", args);
+			video_ffmpeg = bp::child{bp::search_path("ffmpeg"), args, bp::std_out > video};
+		}
+#endif
+	}
+
+#ifdef LINUX
+	// a second of audio
+	enlarge_pipe(audio.native_source(), _sample_rate * _nb_channels * pcm_sample_size());
+	// a few frames, so that ffmpeg can decode ahead
+	if (with_video)
+		enlarge_pipe(video.native_source(), 4 * video_frame_bytes());
+#endif
+}
+
+void FfmpegCliBoostMedia::restart(const double start)
+{
+#ifndef _WIN32
+	audio_pump.reset();
+	video_pump.reset();
+#endif
+	audio.close();
+	video.close();
+	// don't wait for ffmpeg to notice the closed pipes; it may be in the middle of decoding a keyframe
+	for (auto *const child : {&ffmpeg, &video_ffmpeg})
+		if (child->valid())
+		{
+			std::error_code ec;
+			child->terminate(ec);
+			child->wait(ec);
+		}
+
+	audio = {};
+	video = {};
+	spawn(start);
 }
 
 FfmpegCliBoostMedia::~FfmpegCliBoostMedia()
 {
+#ifndef _WIN32
+	audio_pump.reset();
+	video_pump.reset();
+#endif
+	// ffmpeg exits once it can't write to the pipes anymore
 	audio.close();
 	video.close();
-	audioc.wait();
-	videoc.wait();
+	ffmpeg.wait();
+	if (video_ffmpeg.valid())
+		video_ffmpeg.wait();
 }
 
-size_t FfmpegCliBoostMedia::read_audio_samples(float *const buf, const int samples)
+size_t FfmpegCliBoostMedia::read_audio_bytes(void *const buf, const size_t bytes)
 {
-	const auto bytes_read = audio.read(buf, samples);
-	return bytes_read / sizeof(float);
+#ifndef _WIN32
+	if (audio_pump)
+		return audio_pump->read(buf, bytes);
+#endif
+	return audio.read(static_cast<char *>(buf), bytes);
 }
 
-bool FfmpegCliBoostMedia::read_video_frame(sf::Texture &txr)
+size_t FfmpegCliBoostMedia::read_video_bytes(void *const buf, const size_t bytes)
 {
-	if (!txr.resize(video_size))
-		throw std::runtime_error{"texture resize failed!"};
-	const auto bytes_to_read = 4 * video_size.x * video_size.y;
-	int bytes_read = 0;
-	while (bytes_read < bytes_to_read)
-	{
-		const auto _bytes_read = video.read(video_buffer.data() + bytes_read, bytes_to_read - bytes_read);
-		if (!_bytes_read)
-			return false;
-		bytes_read += _bytes_read;
-	}
-	txr.update(video_buffer.data());
-	return true;
+#ifndef _WIN32
+	if (video_pump)
+		return video_pump->read(buf, bytes);
+#endif
+	return video.read(static_cast<char *>(buf), bytes);
 }
@@ -0,0 +1,215 @@
+#include "media/FfmpegCliMedia.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef LINUX
+#include <fcntl.h>
+#include <fstream>
+#endif
+
+FfmpegCliMedia::FfmpegCliMedia(
+	const Source &source, const sf::Vector2u video_size, const PcmFormat pcm_format, const int sample_rate)
+	: Media{source, video_size, sample_rate},
+	  pcm_format{pcm_format}
+{
+}
+
+const char *FfmpegCliMedia::pcm_format_name() const
+{
+	switch (pcm_format)
+	{
+	case PcmFormat::F32LE:
+		return "f32le";
+	case PcmFormat::S16LE:
+		return "s16le";
+	default:
+		throw std::logic_error{"unknown pcm format"};
+	}
+}
+
+size_t FfmpegCliMedia::pcm_sample_size() const
+{
+	return (pcm_format == PcmFormat::F32LE) ? sizeof(float) : sizeof(int16_t);
+}
+
+size_t FfmpegCliMedia::read_audio_samples(float *const buf, const int samples)
+{
+	if (pcm_format != PcmFormat::F32LE)
+		throw std::logic_error{"read_audio_samples: pipe format is not f32le"};
+	return read_audio_bytes(buf, samples * sizeof(float)) / sizeof(float);
+}
+
+void FfmpegCliMedia::decode_audio(const int frames)
+{
+	const auto nb_channels = _nb_channels;
+	const auto frame_size = pcm_sample_size() * nb_channels;
+
+	while (_audio_buffer.frames() < frames)
+	{
+		// only read what's missing, right behind the incomplete frame from last time
+		const auto bytes_to_read = (frames - _audio_buffer.frames()) * frame_size - _pcm_buffer_fill;
+		if (_pcm_buffer.size() < _pcm_buffer_fill + bytes_to_read)
+			_pcm_buffer.resize(_pcm_buffer_fill + bytes_to_read);
+
+		const auto bytes_read = read_audio_bytes(_pcm_buffer.data() + _pcm_buffer_fill, bytes_to_read);
+		if (!bytes_read)
+			return;
+		_pcm_buffer_fill += bytes_read;
+
+		const int frames_read = _pcm_buffer_fill / frame_size;
+		const auto samples_read = frames_read * nb_channels;
+
+		if (pcm_format == PcmFormat::F32LE)
+			write_audio(reinterpret_cast<const float *>(_pcm_buffer.data()), frames_read);
+		else
+		{
+			if ((int)_converted.size() < samples_read)
+				_converted.resize(samples_read);
+
+			// a plain loop over restrict pointers, so that it vectorizes; see CMakeLists.txt
+			const int16_t *const __restrict in = reinterpret_cast<const int16_t *>(_pcm_buffer.data());
+			float *const __restrict out = _converted.data();
+			for (int i = 0; i < samples_read; ++i)
+				out[i] = in[i] * (1.f / 32768);
+
+			write_audio(out, frames_read);
+		}
+
+		// keep the incomplete frame, if any
+		const auto used = frames_read * frame_size;
+		std::memmove(_pcm_buffer.data(), _pcm_buffer.data() + used, _pcm_buffer_fill - used);
+		_pcm_buffer_fill -= used;
+	}
+}
+
+bool FfmpegCliMedia::read_video_frame(sf::Texture &txr)
+{
+	if (_video_format != VideoFormat::RGBA)
+		throw std::logic_error{"read_video_frame: yuv frames can't be uploaded as rgba"};
+	if (!txr.resize(video_size))
+		throw std::runtime_error{"texture resize failed!"};
+	_video_buffer.resize(video_frame_bytes());
+	if (!read_video_frame(_video_buffer))
+		return false;
+	txr.update(_video_buffer.data());
+	return true;
+}
+
+bool FfmpegCliMedia::read_video_frame(const std::span<uint8_t> pixels)
+{
+	if (pixels.size() < video_frame_bytes())
+		throw std::invalid_argument{"read_video_frame: buffer too small for one frame"};
+
+	const auto bytes_to_read = video_frame_bytes();
+	size_t bytes_read = 0;
+	while (bytes_read < bytes_to_read)
+	{
+		const auto _bytes_read = read_video_bytes(pixels.data() + bytes_read, bytes_to_read - bytes_read);
+		if (!_bytes_read)
+			return false;
+		bytes_read += _bytes_read;
+	}
+	_video_frame_time = _start_time + (double)_video_frames_read++ * _video_frame_rate.den / _video_frame_rate.num;
+	return true;
+}
+
+void FfmpegCliMedia::seek(const double seconds)
+{
+	const auto start = std::max(seconds, 0.);
+	restart(start);
+	_pcm_buffer_fill = 0;
+	_video_frames_read = 0;
+	_start_time = start;
+	_audio_buffer.clear();
+}
+
+std::vector<std::string> FfmpegCliMedia::start_args(const double start)
+{
+	if (start <= 0)
+		return {};
+	return {"-ss", std::to_string(start)};
+}
+
+void FfmpegCliMedia::choose_video_format(const bool yuv, const VideoScalePath &path)
+{
+	if (!yuv || video_size.x % 4 || video_size.y % 2)
+		_video_format = VideoFormat::RGBA;
+	else if (!path.vaapi_device.empty() && _video_filter.empty())
+		_video_format = VideoFormat::NV12;
+	else
+		_video_format = VideoFormat::YUV420P;
+}
+
+const char *FfmpegCliMedia::pix_fmt_name() const
+{
+	switch (_video_format)
+	{
+	case VideoFormat::RGBA:
+		return "rgba";
+	case VideoFormat::YUV420P:
+		return "yuv420p";
+	case VideoFormat::NV12:
+		return "nv12";
+	default:
+		throw std::logic_error{"unknown video format"};
+	}
+}
+
+std::string FfmpegCliMedia::fps_filter() const
+{
+	return "fps=" + std::to_string(_video_frame_rate.num) + '/' + std::to_string(_video_frame_rate.den);
+}
+
+std::vector<std::string> FfmpegCliMedia::probe_hint_args() const
+{
+	const auto &format = *_reader;
+	std::vector<std::string> args{"-fpsprobesize", "0"};
+
+	// e.g. "mov,mp4,m4a,3gp,3g2,mj2": any of the names selects the same demuxer
+	const std::string_view names{format->iformat->name};
+	args.insert(args.end(), {"-f", std::string{names.substr(0, names.find(','))}});
+
+	// demuxers without their own io (e.g. devices) have no byte count; leave those alone
+	if (format->pb)
+	{
+		// some slack, since buffering can make ffmpeg read a little differently than we did
+		const auto probesize = std::max<int64_t>(format->pb->bytes_read + (64 << 10), 32);
+		args.insert(args.end(), {"-probesize", std::to_string(probesize)});
+	}
+
+	return args;
+}
+
+std::vector<std::string> FfmpegCliMedia::resample_args() const
+{
+	if (_sample_rate == _astream->sample_rate())
+		return {};
+	return {"-ar", std::to_string(_sample_rate)};
+}
+
+std::string FfmpegCliMedia::audio_map() const
+{
+	return "0:" + std::to_string((*_astream)->index);
+}
+
+std::string FfmpegCliMedia::video_map() const
+{
+	return "0:" + std::to_string((*_vstream)->index);
+}
+
+void FfmpegCliMedia::enlarge_pipe(const int fd, const int bytes)
+{
+#ifdef LINUX
+	// unprivileged processes can't go beyond this
+	static const int max_size = []
+	{
+		int size = 1 << 20;
+		std::ifstream{"/proc/sys/fs/pipe-max-size"} >> size;
+		return size;
+	}();
+	fcntl(fd, F_SETPIPE_SZ, std::min(bytes, max_size));
+#endif
+}
@@ -1,23 +1,37 @@
 #include "media/FfmpegCliPopenMedia.hpp"
+#include "media/VideoScalePath.hpp"
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <utility>
 
-FfmpegCliPopenMedia::FfmpegCliPopenMedia(const std::string &url, const sf::Vector2u video_size)
-	: FfmpegCliMedia{url, video_size}
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FfmpegCliPopenMedia::FfmpegCliPopenMedia(
+	const Source &source, const sf::Vector2u video_size, const PcmFormat pcm_format,
+	const int max_video_fps,
+	const std::string &video_filter,
+	const bool yuv_video,
+	const int sample_rate)
+	: FfmpegCliMedia{source, video_size, pcm_format, sample_rate}
 {
 	{ // read attached pic
-		const auto &streams = _format.streams();
+		const auto &streams = _reader->streams();
 		if (const auto itr = std::ranges::find_if(
 				streams, [](const auto &s) { return s->disposition & AV_DISPOSITION_ATTACHED_PIC; });
 			itr != streams.cend())
 		{
 			const auto &stream = *itr;
-			_attached_pic = {stream->attached_pic.data, stream->attached_pic.size};
+			_attached_pic_data = {stream->attached_pic.data, (size_t)stream->attached_pic.size};
 		}
 	}
 
 	try // find video stream
 	{
-		const auto stream = _format.find_best_stream(AVMEDIA_TYPE_VIDEO);
+		const auto stream = _reader->find_best_stream(AVMEDIA_TYPE_VIDEO);
 		// we don't want to re-decode the attached pic stream
 		if (!(stream->disposition & AV_DISPOSITION_ATTACHED_PIC))
 			_vstream = stream;
@@ -27,95 +41,178 @@ FfmpegCliPopenMedia::FfmpegCliPopenMedia(const std::string &url, const sf::Vecto
 		std::cerr << e.what() << '\n';
 	}
 
-	{ // create audio decoder
-		std::ostringstream ss;
-		ss << "ffmpeg -v warning -hwaccel auto ";
+	with_video = _vstream && video_size.x && video_size.y;
+	if (with_video)
+	{
+		_video_frame_rate = capped_video_rate(max_video_fps);
+		_video_filter = video_filter;
+	}
 
-		if (url.contains("http"))
-			ss << "-reconnect 1 ";
+	std::ostringstream input_ss;
+	input_ss << "ffmpeg -v warning -hwaccel auto ";
 
+	if (url.contains("http"))
+		input_ss << "-reconnect 1 ";
+
+	// demuxer names and numbers only, nothing to quote
+	for (const auto &arg : probe_hint_args())
+		input_ss << arg << ' ';
+	input_args = input_ss.str();
+
+	std::ostringstream audio_ss;
+	audio_ss << "-map " << audio_map() << " -vn -c:a pcm_" << pcm_format_name() << " -f " << pcm_format_name() << ' ';
+	for (const auto &arg : resample_args())
+		audio_ss << arg << ' ';
+	audio_args = audio_ss.str();
+
+	if (with_video)
+	{
+		std::ostringstream video_ss;
+		video_ss << "-an -map " << video_map() << ' ';
+
+		const auto &scale_path = VideoScalePath::best();
+		choose_video_format(yuv_video, scale_path);
+		// none of these contain quotes
+		for (const auto &arg : scale_path.args(video_size, fps_filter(), _video_filter))
 #ifdef _WIN32
-		ss << "-i \"" << url << "\" ";
+			video_ss << '"' << arg << "\" ";
 #else
-		if (url.contains('\''))
-			ss << "-i \"" << url << "\" ";
-		else
-			ss << "-i '" << url << "' ";
+			video_ss << '\'' << arg << "' ";
 #endif
 
-		ss << "-f f32le - ";
-
-		if (!(audio = popen(ss.str().c_str(), "r")))
-			throw std::runtime_error{std::string{"popen: "} + strerror(errno)};
+		video_ss << "-pix_fmt " << pix_fmt_name() << ' ';
+		video_ss << "-f rawvideo ";
+		video_ss << "-";
+		video_args = video_ss.str();
 	}
 
-	if (_vstream && video_size.x && video_size.y)
-	{ // create video decoder
-		std::ostringstream ss;
-		ss << "ffmpeg ";
-		ss << "-v warning ";
-		ss << "-hwaccel auto ";
-
-		if (url.contains("http"))
-			ss << "-reconnect 1 ";
+	spawn(0);
+}
 
-		if (url.contains('\''))
-			ss << "-i \"" << url << "\" ";
-		else
-			ss << "-i '" << url << "' ";
+void FfmpegCliPopenMedia::spawn(const double start)
+{
+	std::ostringstream input;
+	input << input_args;
 
-// this needs more work!!!!!!!!!!
-// need to determine whether vaapi works on the system before using vaapi
-// also change quoting for windows
+	// the seek position is an input option, so it goes right before the input
+	for (const auto &arg : start_args(start))
+		input << arg << ' ';
 
-#ifdef LINUX
-		ss << "-vaapi_device /dev/dri/renderD129 ";
-		ss << "-vf 'format=nv12,hwupload,scale_vaapi=" << video_size.x << ':' << video_size.y << ",hwdownload' ";
+#ifdef _WIN32
+	input << "-i \"" << url << "\" ";
 #else
-		ss << "-s " << video_size.x << 'x' << video_size.y << ' ';
+	if (url.contains('\''))
+		input << "-i \"" << url << "\" ";
+	else
+		input << "-i '" << url << "' ";
 #endif
 
-		ss << "-pix_fmt rgba ";
-		ss << "-f rawvideo ";
-		ss << "-";
+#ifndef _WIN32
+	if (with_video)
+	{ // one process for both streams: audio goes to an inherited pipe, video to stdout
+		int fds[2];
+		if (pipe(fds) == -1)
+			throw std::runtime_error{std::string{"pipe: "} + strerror(errno)};
+		// only the write end may be inherited, otherwise ffmpeg would keep our read end open
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		audio_fd = fds[0];
 
-		if (!(video = popen(ss.str().c_str(), "r")))
-			perror("popen");
+		std::ostringstream ss;
+		ss << input.str() << audio_args << "pipe:" << fds[1] << ' ' << video_args;
+		video = popen(ss.str().c_str(), "r");
+		const auto popen_errno = errno;
+
+		// ffmpeg has its copy of the write end now; ours would prevent eof
+		close(fds[1]);
+		if (!video)
+			throw std::runtime_error{std::string{"popen: "} + strerror(popen_errno)};
+		setvbuf(video, nullptr, _IONBF, 0);
+
+		// ffmpeg interleaves both streams, so audio never gets far ahead of video: a few seconds is plenty
+		audio_pump.emplace(audio_fd, 4 * _sample_rate * _nb_channels * pcm_sample_size());
+		// a few frames: we read video by timestamp, so it never falls far behind the audio
+		video_pump.emplace(fileno(video), 4 * video_frame_bytes());
 	}
+	else
+#endif
+	{ // create audio decoder
+		if (!(audio = popen((input.str() + audio_args + '-').c_str(), "r")))
+			throw std::runtime_error{std::string{"popen: "} + strerror(errno)};
+
+		// reads are already large, so let them go straight from the pipe into our buffers
+		setvbuf(audio, nullptr, _IONBF, 0);
+
+#ifdef _WIN32
+		// no way to hand ffmpeg a second pipe here, so video gets its own process
+		if (with_video)
+		{ // create video decoder
+			if (!(video = popen((input.str() + video_args).c_str(), "r")))
+				perror("popen");
+			else
+				setvbuf(video, nullptr, _IONBF, 0);
+		}
+#endif
+	}
+
+#ifdef LINUX
+	// a second of audio
+	enlarge_pipe(audio ? fileno(audio) : audio_fd, _sample_rate * _nb_channels * pcm_sample_size());
+	// a few frames, so that ffmpeg can decode ahead
+	if (video)
+		enlarge_pipe(fileno(video), 4 * video_frame_bytes());
+#endif
 }
 
-FfmpegCliPopenMedia::~FfmpegCliPopenMedia()
+void FfmpegCliPopenMedia::close_pipes()
 {
-	if (audio && pclose(audio) == -1)
+#ifndef _WIN32
+	audio_pump.reset();
+	video_pump.reset();
+	// ffmpeg exits once it can't write to the pipes anymore
+	if (audio_fd != -1)
+		close(std::exchange(audio_fd, -1));
+#endif
+	if (audio && pclose(std::exchange(audio, nullptr)) == -1)
 		perror("pclose");
-	if (video && pclose(video) == -1)
+	if (video && pclose(std::exchange(video, nullptr)) == -1)
 		perror("pclose");
 }
 
-size_t FfmpegCliPopenMedia::read_audio_samples(float *const buf, const int samples)
+void FfmpegCliPopenMedia::restart(const double start)
 {
+	close_pipes();
+	spawn(start);
+}
+
+FfmpegCliPopenMedia::~FfmpegCliPopenMedia()
+{
+	close_pipes();
+}
+
+size_t FfmpegCliPopenMedia::read_audio_bytes(void *const buf, const size_t bytes)
+{
+#ifndef _WIN32
+	if (audio_pump)
+		return audio_pump->read(buf, bytes);
+#endif
 	if (!audio)
 		throw std::logic_error{"no audio stream"};
-	const auto samples_read = fread(buf, sizeof(float), samples, audio);
-	if (const auto err = ferror(audio))
+	const auto bytes_read = fread(buf, 1, bytes, audio);
+	if (ferror(audio))
 		std::cerr << "audio stream error: " << strerror(errno) << '\n';
-	return samples_read;
+	return bytes_read;
 }
 
-bool FfmpegCliPopenMedia::read_video_frame(sf::Texture &txr)
+size_t FfmpegCliPopenMedia::read_video_bytes(void *const buf, const size_t bytes)
 {
+#ifndef _WIN32
+	if (video_pump)
+		return video_pump->read(buf, bytes);
+#endif
 	if (!video)
 		throw std::runtime_error{"no video stream available!"};
-	if (!txr.resize(video_size))
-		throw std::runtime_error{"texture resize failed!"};
-	const auto bytes_to_read = 4 * video_size.x * video_size.y;
-	uint8_t buf[bytes_to_read];
-	if (fread(buf, sizeof(uint8_t), bytes_to_read, video) < bytes_to_read)
-	{
-		if (const auto err = ferror(video))
-			std::cerr << "video error: " << strerror(err) << '\n';
-		return false;
-	}
-	txr.update(buf);
-	return true;
+	const auto bytes_read = fread(buf, 1, bytes, video);
+	if (ferror(video))
+		std::cerr << "video error: " << strerror(errno) << '\n';
+	return bytes_read;
 }
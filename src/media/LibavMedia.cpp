@@ -1,36 +1,72 @@
 #include "media/LibavMedia.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
-LibavMedia::LibavMedia(const std::string &url, const sf::Vector2u vsize)
-	: Media{url, vsize}
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+
+LibavMedia::FrameSlot::FrameSlot(const sf::Vector2u size)
+{
+	frame->format = AV_PIX_FMT_RGBA;
+	frame->width = size.x;
+	frame->height = size.y;
+	// no row padding, so the frame can be uploaded or copied as is
+	if (av_frame_get_buffer(frame, 1) < 0)
+		throw std::runtime_error{"av_frame_get_buffer failed"};
+}
+
+LibavMedia::LibavMedia(const Source &source, const sf::Vector2u vsize, const int max_video_fps)
+	: Media{source, vsize}
 {
 	// if an attached pic is in the format, use it for bg and album cover
 	if (const auto itr = std::ranges::find_if(
-			_format.streams(), [](const auto &s) { return s->disposition & AV_DISPOSITION_ATTACHED_PIC; });
-		itr != _format.streams().cend())
+			_reader->streams(), [](const auto &s) { return s->disposition & AV_DISPOSITION_ATTACHED_PIC; });
+		itr != _reader->streams().cend())
 	{
 		const auto &stream = *itr;
-		_attached_pic = {stream->attached_pic.data, stream->attached_pic.size};
+		_attached_pic_data = {stream->attached_pic.data, (size_t)stream->attached_pic.size};
 	}
 
 	try
 	{
-		const auto _s = _format.find_best_stream(AVMEDIA_TYPE_VIDEO);
-		// we don't want to re-decode the attached pic stream
-		if (!(_s->disposition & AV_DISPOSITION_ATTACHED_PIC))
+		const auto _s = _reader->find_best_stream(AVMEDIA_TYPE_VIDEO);
+		// we don't want to re-decode the attached pic stream,
+		// and no size means video isn't wanted (swscale can't scale to nothing anyway)
+		if (!(_s->disposition & AV_DISPOSITION_ATTACHED_PIC) && vsize.x && vsize.y)
 		{
 			_vstream = _s;
-			_vdecoder.emplace(avcodec_find_decoder(_s->codecpar->codec_id)).open();
-			_scaler.emplace(
-				av::SwScaler::SrcDstArgs{
-					av::nearest_multiple_8(_s->codecpar->width),
-					_s->codecpar->height,
-					(AVPixelFormat)_s->codecpar->format,
-				},
-				av::SwScaler::SrcDstArgs{vsize.x, vsize.y, AV_PIX_FMT_RGBA});
-			_scaled_frame.emplace();
-			_frame_queue.emplace();
+			_video_frame_rate = capped_video_rate(max_video_fps);
+			_drop_frames = av_cmp_q(_video_frame_rate, capped_video_rate(0)) < 0;
+			auto &vdecoder = _vdecoder.emplace(avcodec_find_decoder(_s->codecpar->codec_id));
+			vdecoder.copy_params(_s->codecpar);
+			// let libavcodec pick the thread count: frame threading decodes several frames at once,
+			// slice threading splits up each frame for codecs that support it
+			vdecoder->thread_count = 0;
+			vdecoder->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+			vdecoder.open();
+
+			// swscale only slices across threads if set up through options
+			_scaler.reset(sws_alloc_context());
+			const auto sws = _scaler.get();
+			av_opt_set_int(sws, "srcw", _s->codecpar->width, 0);
+			av_opt_set_int(sws, "srch", _s->codecpar->height, 0);
+			av_opt_set_int(sws, "src_format", _s->codecpar->format, 0);
+			av_opt_set_int(sws, "dstw", vsize.x, 0);
+			av_opt_set_int(sws, "dsth", vsize.y, 0);
+			av_opt_set_int(sws, "dst_format", AV_PIX_FMT_RGBA, 0);
+			av_opt_set_int(sws, "sws_flags", SWS_BILINEAR, 0);
+			av_opt_set_int(sws, "threads", 0, 0); // one per cpu
+			if (sws_init_context(sws, nullptr, nullptr) < 0)
+				throw std::runtime_error{"sws_init_context failed"};
+
+			// the video decoder's frame threads hold a few packets each; more are queued while audio runs ahead
+			_video_packets.emplace(256);
+			_frame_queue.emplace(max_queued_frames, FrameSlot{vsize});
 		}
 	}
 	catch (const av::Error &e)
@@ -49,14 +85,14 @@ LibavMedia::LibavMedia(const std::string &url, const sf::Vector2u vsize)
 	}
 
 	// this check is necessary for .wav files with no channel order information
-	if (_astream->codecpar->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
-		_astream->codecpar->ch_layout.order = AV_CHANNEL_ORDER_NATIVE;
+	if ((*_astream)->codecpar->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+		(*_astream)->codecpar->ch_layout.order = AV_CHANNEL_ORDER_NATIVE;
 
 	// resampler initialization
-	rs_frame->ch_layout = _astream->codecpar->ch_layout;
-	rs_frame->sample_rate = _astream->codecpar->sample_rate;
-	rs_frame->format = AV_SAMPLE_FMT_FLT;
-	_adecoder.copy_params(_astream->codecpar);
+	rs_frame->ch_layout = (*_astream)->codecpar->ch_layout;
+	rs_frame->sample_rate = (*_astream)->codecpar->sample_rate;
+	rs_frame->format = AV_SAMPLE_FMT_FLTP;
+	_adecoder.copy_params((*_astream)->codecpar);
 	_adecoder.open();
 
 	// TODO: NEED TO EXPERIMENT WITH USING THE FFMPEG CLI INSTEAD OF CALLING LIBAV
@@ -68,33 +104,179 @@ LibavMedia::LibavMedia(const std::string &url, const sf::Vector2u vsize)
 	switch (_adecoder->codec_id)
 	{
 	case AV_CODEC_ID_MP3:
-		// _format.seek_file(-1, 1, 1, 1, AVSEEK_FLAG_FRAME);
-		_format.seek_frame(-1, 0, AVSEEK_FLAG_BACKWARD);
+		// _reader->seek_file(-1, 1, 1, 1, AVSEEK_FLAG_FRAME);
+		_reader->seek_frame(-1, 0, AVSEEK_FLAG_BACKWARD);
 		break;
 	default:
 		break;
 	}
+
+	_planes.resize(_nb_channels);
+	start_threads();
 }
 
-void LibavMedia::decode_audio(const int frames)
+LibavMedia::~LibavMedia()
+{
+	_demuxer.request_stop();
+	_audio_decoder.request_stop();
+	_video_decoder.request_stop();
+	signal_progress();
+}
+
+void LibavMedia::start_threads()
+{
+	_demuxer = std::jthread{[this](const std::stop_token st) { demux(st); }};
+	_audio_decoder = std::jthread{[this](const std::stop_token st) { decode_audio_packets(st); }};
+	if (_vstream)
+		_video_decoder = std::jthread{[this](const std::stop_token st) { decode_video_packets(st); }};
+}
+
+void LibavMedia::stop_threads()
+{
+	_demuxer.request_stop();
+	_audio_decoder.request_stop();
+	_video_decoder.request_stop();
+	signal_progress();
+	for (auto *const thread : {&_demuxer, &_audio_decoder, &_video_decoder})
+		if (thread->joinable())
+			thread->join();
+}
+
+// libavpp only exposes the codec context through `operator->`
+static void flush_decoder(av::Decoder &decoder)
+{
+	avcodec_flush_buffers(decoder.operator->());
+}
+
+void LibavMedia::seek(const double seconds)
+{
+	stop_threads();
+
+	// with every thread stopped, this one may act as both producer and consumer of the queues
+	const auto drain_packets = [](tt::SpscQueue<PacketSlot> &queue)
+	{
+		for (PacketSlot *slot; (slot = queue.front()); queue.pop())
+			av_packet_unref(slot->packet);
+	};
+	drain_packets(_audio_packets);
+	while (_audio_blocks.front())
+		_audio_blocks.pop();
+	if (_vstream)
+	{
+		drain_packets(*_video_packets);
+		while (_frame_queue->front())
+			_frame_queue->pop();
+	}
+
+	// the video decoder needs the keyframe before `seconds`, the audio decoder is fine with any packet
+	const auto &stream = _vstream ? *_vstream->get() : *_astream->get();
+	const auto start = (stream.start_time == AV_NOPTS_VALUE) ? 0 : stream.start_time;
+	_seek_time = std::max(seconds, 0.);
+	std::exception_ptr error;
+	try
+	{
+		_reader->seek_frame(stream.index, start + (int64_t)(_seek_time / av_q2d(stream.time_base)), AVSEEK_FLAG_BACKWARD);
+	}
+	catch (...)
+	{
+		// e.g. an unseekable network stream; keep going from wherever the demuxer is
+		error = std::current_exception();
+	}
+
+	flush_decoder(_adecoder);
+	if (_vdecoder)
+		flush_decoder(*_vdecoder);
+	_trim_audio = true;
+	_next_frame_time = 0;
+	_demux_eof = _audio_eof = _video_eof = false;
+	_demux_error = _audio_error = _video_error = nullptr;
+	_audio_buffer.clear();
+
+	start_threads();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void LibavMedia::signal_progress()
 {
-	const auto samples = frames * _astream.nb_channels();
-	while (_audio_buffer.size() < samples)
+	++_progress;
+	_progress.notify_all();
+}
+
+template <typename Ready>
+bool LibavMedia::wait_until(const std::stop_token &st, const Ready ready)
+{
+	while (true)
 	{
-		const auto packet = _format.read_packet();
+		// read before checking anything: any progress after this, including the destructor's, wakes the wait below
+		const auto seen = _progress.load();
+		if (st.stop_requested())
+			return false;
+		if (ready())
+			return true;
+		_progress.wait(seen);
+	}
+}
 
-		if (!packet)
+void LibavMedia::demux(const std::stop_token st)
+{
+	try
+	{
+		while (const auto packet = _reader->read_packet())
 		{
-			std::cerr << "packet is null; format probably reached eof\n";
-			return;
+			tt::SpscQueue<PacketSlot> *queue{};
+			if (packet->stream_index == (*_astream)->index)
+				queue = &_audio_packets;
+			else if (_vstream && packet->stream_index == _vstream->get()->index)
+				queue = &*_video_packets;
+			else
+				continue;
+
+			const auto waits_on_video = queue != &_audio_packets && !queue->back();
+			if (waits_on_video)
+			{
+				_demux_waits_on_video = true;
+				signal_progress();
+			}
+			const auto ready = wait_until(st, [&] { return queue->back(); });
+			_demux_waits_on_video = false;
+			if (!ready)
+				return;
+			if (av_packet_ref(queue->back()->packet, packet) < 0)
+				throw std::runtime_error{"av_packet_ref failed"};
+			queue->push();
+			signal_progress();
 		}
+		std::cerr << "packet is null; format probably reached eof\n";
+	}
+	catch (...)
+	{
+		_demux_error = std::current_exception();
+	}
+	_demux_eof = true;
+	signal_progress();
+}
 
-		if (packet->stream_index == _astream->index)
+void LibavMedia::decode_audio_packets(const std::stop_token st)
+{
+	try
+	{
+		while (true)
 		{
-			std::cout << "\e[1A\e[2K\raudio: " << (packet->pts * av_q2d(_astream->time_base)) << " / "
-					  << _astream.duration_sec() << '\n';
+			if (!wait_until(st, [&] { return _audio_packets.front() || _demux_eof; }))
+				return;
+			auto slot = _audio_packets.front();
+			// the demuxer sets `_demux_eof` after its last push, so check the queue once more
+			if (!slot && !(slot = _audio_packets.front()))
+				break;
+
+			const auto packet = slot->packet;
+			const auto sent = _adecoder.send_packet(packet);
+			av_packet_unref(packet);
+			_audio_packets.pop();
+			signal_progress();
 
-			if (!_adecoder.send_packet(packet))
+			if (!sent)
 			{
 				std::cerr << "audio decoder has been flushed\n";
 				continue;
@@ -103,47 +285,201 @@ void LibavMedia::decode_audio(const int frames)
 			while (const auto frame = _adecoder.receive_frame())
 			{
 				_resampler.convert_frame(rs_frame.get(), frame);
-				const auto data = reinterpret_cast<const float *>(rs_frame->extended_data[0]);
-				const auto nb_floats = _astream.nb_channels() * rs_frame->nb_samples;
-				_audio_buffer.insert(_audio_buffer.end(), data, data + nb_floats);
+
+				// after a seek: drop what comes before the seek time, down to the sample
+				int skip = 0;
+				if (_trim_audio && frame->best_effort_timestamp != AV_NOPTS_VALUE)
+				{
+					const auto &stream = *_astream->get();
+					const auto start = (stream.start_time == AV_NOPTS_VALUE) ? 0 : stream.start_time;
+					const auto time = (frame->best_effort_timestamp - start) * av_q2d(stream.time_base);
+					skip = std::clamp<int>(std::lround((_seek_time - time) * _sample_rate), 0, rs_frame->nb_samples);
+					if (skip == rs_frame->nb_samples)
+						continue;
+				}
+				_trim_audio = false;
+
+				if (!wait_until(st, [&] { return _audio_blocks.back(); }))
+					return;
+				const auto block = _audio_blocks.back();
+				const auto nb_channels = _nb_channels;
+				block->frames = rs_frame->nb_samples - skip;
+				if ((int)block->samples.size() < nb_channels * block->frames)
+					block->samples.resize(nb_channels * block->frames);
+				for (int c = 0; c < nb_channels; ++c)
+					std::memcpy(
+						block->samples.data() + c * block->frames,
+						reinterpret_cast<const float *>(rs_frame->extended_data[c]) + skip,
+						block->frames * sizeof(float));
+				_audio_blocks.push();
+				signal_progress();
 			}
 		}
-		else if (_vstream && packet->stream_index == _vstream->get()->index)
-		{
-			// we can access all of the video-related optionals in this block
-			std::cout << "\e[2K\rvideo: " << (packet->pts * av_q2d(_vstream->get()->time_base)) << " / "
-					  << _vstream->duration_sec();
+	}
+	catch (...)
+	{
+		_audio_error = std::current_exception();
+	}
+	_audio_eof = true;
+	signal_progress();
+}
 
-			if (!_vdecoder->send_packet(packet))
+void LibavMedia::decode_video_packets(const std::stop_token st)
+{
+	try
+	{
+		while (true)
+		{
+			if (!wait_until(st, [&] { return _video_packets->front() || _demux_eof; }))
+				return;
+			auto slot = _video_packets->front();
+			// the demuxer sets `_demux_eof` after its last push, so check the queue once more
+			if (!slot && !(slot = _video_packets->front()))
+				// flush the frames still held by the decoder's threads
+				_vdecoder->send_packet(nullptr);
+			else
 			{
-				std::cerr << "video decoder has been flushed\n";
-				continue;
+				const auto packet = slot->packet;
+				const auto sent = _vdecoder->send_packet(packet);
+				av_packet_unref(packet);
+				_video_packets->pop();
+				signal_progress();
+
+				if (!sent)
+				{
+					std::cerr << "video decoder has been flushed\n";
+					continue;
+				}
 			}
 
 			while (const auto frame = _vdecoder->receive_frame())
 			{
-				_scaler->scale_frame(_scaled_frame->get(), frame);
-				// put a frame into an sf::Texture, then put that into a frame queue.
-				// we are going to be reading more packets than usual since
-				// we need more audio samples than is provided by one audio packet.
-
-				// create new texture object in-place at the end of the list
-				_frame_queue->emplace_back(sf::Vector2u{_scaled_frame->get()->width, _scaled_frame->get()->height})
-					.update(_scaled_frame->get()->data[0]);
+				const auto &stream = *_vstream->get();
+				const auto start = (stream.start_time == AV_NOPTS_VALUE) ? 0 : stream.start_time;
+				const auto time = (frame->best_effort_timestamp == AV_NOPTS_VALUE)
+									  ? _next_frame_time
+									  : (frame->best_effort_timestamp - start) * av_q2d(stream.time_base);
+				// after a seek: the frames before the one shown at the seek time
+				if (time + av_q2d(av_inv_q(capped_video_rate(0))) <= _seek_time || !keep_video_frame(time))
+					continue;
+
+				if (!wait_until(st, [&] { return _frame_queue->back() || video_stalls_audio(); }))
+					return;
+				// scales straight into the queued frame, sliced across swscale's threads
+				const auto slot = _frame_queue->back();
+				if (!slot) // dropped, see `video_stalls_audio`
+					continue;
+				if (sws_scale_frame(_scaler.get(), slot->frame, frame) < 0)
+					throw std::runtime_error{"sws_scale_frame failed"};
+				slot->time = time;
+				_frame_queue->push();
+				signal_progress();
 			}
+
+			if (!slot)
+				break;
 		}
 	}
+	catch (...)
+	{
+		_video_error = std::current_exception();
+	}
+	_video_eof = true;
+	signal_progress();
 }
 
-bool LibavMedia::read_video_frame(sf::Texture &txr)
+bool LibavMedia::video_stalls_audio() const
+{
+	// the audio queues' sizes are safe to read from any thread
+	return _demux_waits_on_video && !_audio_packets.size() && _audio_blocks.size() < _audio_blocks.capacity();
+}
+
+bool LibavMedia::keep_video_frame(const double time)
+{
+	const auto interval = av_q2d(av_inv_q(_video_frame_rate));
+	if (!_drop_frames)
+	{
+		_next_frame_time = time + interval;
+		return true;
+	}
+
+	// half a source frame of slack, so that rounded timestamps don't shift which frames are kept
+	const auto slack = 0.5 * av_q2d(av_inv_q(capped_video_rate(0)));
+	if (time < _next_frame_time - slack)
+		return false;
+	_next_frame_time += interval;
+	// after a gap, e.g. in variable frame rate video, continue from this frame instead of catching up
+	if (_next_frame_time < time)
+		_next_frame_time = time + interval;
+	return true;
+}
+
+void LibavMedia::decode_audio(const int frames)
+{
+	while (_audio_buffer.frames() < frames)
+	{
+		wait_until({}, [&] { return _audio_blocks.front() || _audio_eof; });
+		auto block = _audio_blocks.front();
+		// the decoder sets `_audio_eof` after its last push, so check the queue once more
+		if (!block && !(block = _audio_blocks.front()))
+		{
+			if (_demux_error)
+				std::rethrow_exception(std::exchange(_demux_error, nullptr));
+			if (_audio_error)
+				std::rethrow_exception(std::exchange(_audio_error, nullptr));
+			return;
+		}
+
+		for (int c = 0; c < (int)_planes.size(); ++c)
+			_planes[c] = block->samples.data() + c * block->frames;
+		write_audio(_planes.data(), block->frames);
+		_audio_blocks.pop();
+		signal_progress();
+	}
+}
+
+const AVFrame *LibavMedia::next_video_frame()
 {
 	if (!_frame_queue)
 		throw std::runtime_error{"no video stream!"};
-	if (!txr.resize(video_size))
+
+	wait_until({}, [&] { return _frame_queue->front() || _video_eof; });
+	// the decoder sets `_video_eof` after its last push, so check the queue once more
+	if (const auto slot = _frame_queue->front())
+	{
+		_video_frame_time = slot->time;
+		return slot->frame;
+	}
+	if (_video_error)
+		std::rethrow_exception(std::exchange(_video_error, nullptr));
+	return nullptr;
+}
+
+bool LibavMedia::read_video_frame(sf::Texture &txr)
+{
+	if (txr.getSize() != video_size && !txr.resize(video_size))
 		throw std::runtime_error{"texture resize failed!"};
-	if (_frame_queue->empty())
+
+	const auto frame = next_video_frame();
+	if (!frame)
+		return false;
+	txr.update(frame->data[0]);
+	_frame_queue->pop();
+	signal_progress();
+	return true;
+}
+
+bool LibavMedia::read_video_frame(const std::span<uint8_t> rgba)
+{
+	const auto bytes = 4 * video_size.x * video_size.y;
+	if (rgba.size() < bytes)
+		throw std::invalid_argument{"read_video_frame: buffer too small for one frame"};
+
+	const auto frame = next_video_frame();
+	if (!frame)
 		return false;
-	txr.update(_frame_queue->front());
-	_frame_queue->pop_front();
+	std::memcpy(rgba.data(), frame->data[0], bytes);
+	_frame_queue->pop();
+	signal_progress();
 	return true;
 }
@@ -0,0 +1,65 @@
+#include "media/LiveMedia.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+LiveMedia::LiveMedia(const std::string &url, const int sample_rate, const int nb_channels, const int block_frames)
+	: Media{url, {}, sample_rate, nb_channels},
+	  block_frames{block_frames},
+	  // allocate every block up front; the queue reuses them
+	  _blocks{queue_blocks, {std::vector<float>((size_t)block_frames * nb_channels)}}
+{
+	if (block_frames <= 0)
+		throw std::invalid_argument{"LiveMedia: block size must be positive"};
+}
+
+void LiveMedia::signal_progress()
+{
+	++_progress;
+	_progress.notify_all();
+}
+
+void LiveMedia::decode_audio(const int frames)
+{
+	while (_audio_buffer.frames() < frames)
+	{
+		const auto seen = _progress.load();
+		if (const auto block = _blocks.front())
+		{
+			write_audio(block->samples.data(), block->frames);
+			_newest_start = _written;
+			_written += block->frames;
+			_newest_captured = block->captured;
+			_blocks.pop();
+			signal_progress();
+			continue;
+		}
+
+		// the producer sets `_eof` after its last push, so check the queue once more
+		if (_eof)
+		{
+			if (_blocks.front())
+				continue;
+			if (_error)
+				std::rethrow_exception(std::exchange(_error, nullptr));
+			return;
+		}
+
+		_progress.wait(seen);
+	}
+}
+
+size_t LiveMedia::read_audio_samples(float *, int)
+{
+	throw std::logic_error{"LiveMedia: use decode_audio"};
+}
+
+double LiveMedia::latency() const
+{
+	if (!_written)
+		return 0;
+	// the oldest buffered frame was captured this long before the newest block's first frame
+	const auto oldest = _written - _audio_buffer.frames();
+	const auto before_newest = ((double)_newest_start - (double)oldest) / _sample_rate;
+	return std::chrono::duration<double>(Clock::now() - _newest_captured).count() + before_newest;
+}
@@ -1,15 +1,156 @@
 #include "media/Media.hpp"
 
-Media::Media(const std::string &url, const sf::Vector2u video_size)
+#include <stdexcept>
+
+Media::Media(const Source &source, const sf::Vector2u video_size, const int sample_rate)
+	: url{source.url},
+	  video_size{video_size},
+	  _reader{source.probe ? source.probe : std::make_shared<av::MediaReader>(source.url)},
+	  _astream{_reader->find_best_stream(AVMEDIA_TYPE_AUDIO)},
+	  _sample_rate{sample_rate ? sample_rate : _astream->sample_rate()},
+	  _nb_channels{_astream->nb_channels()}
+{
+}
+
+Media::Media(const std::string &url, const sf::Vector2u video_size, const int sample_rate, const int nb_channels)
 	: url{url},
 	  video_size{video_size},
-	  _format{url}
+	  _sample_rate{sample_rate},
+	  _nb_channels{nb_channels}
+{
+	if (sample_rate <= 0 || nb_channels <= 0)
+		throw std::invalid_argument{"Media: sample rate and channel count must be positive"};
+}
+
+Media::Media(const Media &probed, const sf::Vector2u video_size)
+	: url{probed.url},
+	  video_size{video_size},
+	  _reader{probed._reader},
+	  _astream{probed._astream},
+	  _sample_rate{probed._sample_rate},
+	  // decorators get already downmixed audio
+	  _nb_channels{probed.nb_channels()},
+	  _vstream{probed._vstream},
+	  _video_frame_rate{probed._video_frame_rate},
+	  _video_filter{probed._video_filter},
+	  _video_format{probed._video_format},
+	  _attached_pic_data{probed._attached_pic_data}
+{
+}
+
+bool Media::read_video_frame(std::span<uint8_t>)
+{
+	throw std::logic_error{"this media backend can't read video frames into memory"};
+}
+
+void Media::seek(double)
+{
+	throw std::logic_error{"this media can't seek"};
+}
+
+const av::MediaReader &Media::format() const
+{
+	if (!_reader)
+		throw std::logic_error{"this media wasn't opened with libav"};
+	return *_reader;
+}
+
+const av::Stream &Media::astream() const
+{
+	if (!_astream)
+		throw std::logic_error{"this media wasn't opened with libav"};
+	return *_astream;
+}
+
+std::optional<std::string> Media::metadata(const std::string &key) const
 {
+	if (!_reader)
+		return {};
+	if (const auto value = _reader->metadata(key.c_str()))
+		return value;
+	if (const auto value = _astream->metadata(key.c_str()))
+		return value;
+	return {};
+}
+
+std::optional<double> Media::duration() const
+{
+	if (!_reader)
+		return {};
+	if (const auto duration = (*_reader)->duration; duration != AV_NOPTS_VALUE && duration > 0)
+		return (double)duration / AV_TIME_BASE;
+	return {};
+}
+
+void Media::set_downmix(std::optional<DownmixMatrix> matrix)
+{
+	if (matrix && matrix->in_channels() != _nb_channels)
+		throw std::invalid_argument{
+			"downmix matrix takes " + std::to_string(matrix->in_channels()) + " channels, but the audio has " +
+			std::to_string(_nb_channels)};
+	_downmix = std::move(matrix);
+	if (const auto channels = _downmix ? _downmix->out_channels() : _nb_channels; channels != nb_channels())
+		_audio_buffer.set_num_channels(channels);
+	else
+		_audio_buffer.clear();
+	_mixed_planes.resize(nb_channels());
+}
+
+void Media::write_audio(const float *const interleaved, const int frames)
+{
+	if (!_downmix)
+		return _audio_buffer.write(interleaved, frames);
+
+	// mix into planar scratch buffers, then copy those into the ring
+	if (_mixed.size() < (size_t)frames * nb_channels())
+		_mixed.resize((size_t)frames * nb_channels());
+	for (int c = 0; c < nb_channels(); ++c)
+		_mixed_planes[c] = _mixed.data() + (size_t)c * frames;
+	_downmix->apply(interleaved, frames, _mixed_planes.data());
+	_audio_buffer.write(_mixed_planes.data(), frames);
+}
+
+void Media::write_audio(const float *const *const planes, const int frames)
+{
+	if (!_downmix)
+		return _audio_buffer.write(planes, frames);
+
+	if (_mixed.size() < (size_t)frames * nb_channels())
+		_mixed.resize((size_t)frames * nb_channels());
+	for (int c = 0; c < nb_channels(); ++c)
+		_mixed_planes[c] = _mixed.data() + (size_t)c * frames;
+	_downmix->apply(planes, frames, _mixed_planes.data());
+	_audio_buffer.write(_mixed_planes.data(), frames);
+}
+
+size_t Media::video_frame_bytes() const
+{
+	const size_t pixels = video_size.x * video_size.y;
+	return (_video_format == VideoFormat::RGBA) ? 4 * pixels : pixels * 3 / 2;
+}
+
+AVRational Media::capped_video_rate(const int max_fps) const
+{
+	if (!_vstream)
+		return {0, 1};
+	auto rate = _vstream->get()->avg_frame_rate;
+	if (rate.num <= 0 || rate.den <= 0)
+		rate = _vstream->get()->r_frame_rate;
+	if (rate.num <= 0 || rate.den <= 0)
+		rate = {25, 1};
+	if (max_fps > 0 && av_cmp_q(AVRational{max_fps, 1}, rate) < 0)
+		rate = {max_fps, 1};
+	return rate;
 }
 
 void Media::audio_buffer_erase(const int frames)
 {
-	const auto begin = _audio_buffer.begin();
-	const auto samples = frames * _astream.nb_channels();
-	_audio_buffer.erase(begin, begin + samples);
+	_audio_buffer.consume(frames);
+}
+
+const std::optional<sf::Texture> &Media::attached_pic() const
+{
+	if (!_attached_pic && !_attached_pic_data.empty())
+		_attached_pic.emplace(_attached_pic_data.data(), _attached_pic_data.size());
+	return _attached_pic;
 }
@@ -0,0 +1,166 @@
+#include "media/MediaFactory.hpp"
+#include "media/FfmpegCliBoostMedia.hpp"
+#include "media/FfmpegCliPopenMedia.hpp"
+#include "media/LibavMedia.hpp"
+#include "media/PcmCacheMedia.hpp"
+#include "media/WavMedia.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+MediaBackend media_backend_from_string(const std::string &name)
+{
+	if (name == "auto")
+		return MediaBackend::AUTO;
+	if (name == "libav")
+		return MediaBackend::LIBAV;
+	if (name == "ffmpeg-boost")
+		return MediaBackend::FFMPEG_BOOST;
+	if (name == "ffmpeg-popen")
+		return MediaBackend::FFMPEG_POPEN;
+	if (name == "wav")
+		return MediaBackend::WAV;
+	throw std::invalid_argument{"unknown media backend: " + name};
+}
+
+const char *to_string(const MediaBackend backend)
+{
+	switch (backend)
+	{
+	case MediaBackend::AUTO:
+		return "auto";
+	case MediaBackend::LIBAV:
+		return "libav";
+	case MediaBackend::FFMPEG_BOOST:
+		return "ffmpeg-boost";
+	case MediaBackend::FFMPEG_POPEN:
+		return "ffmpeg-popen";
+	case MediaBackend::WAV:
+		return "wav";
+	default:
+		throw std::logic_error{"unknown media backend"};
+	}
+}
+
+// whether `url` is opened as pcm wav, which needs no libav probe
+static bool opens_as_wav(const std::string &url, const MediaBackend backend)
+{
+	return backend == MediaBackend::WAV ||
+		   (backend == MediaBackend::AUTO && !url.contains("://") && WavMedia::is_supported(url));
+}
+
+MediaBackend choose_media_backend(const std::string &url, const bool with_video)
+{
+	// wav files have no video, so this doesn't depend on `with_video`
+	if (opens_as_wav(url, MediaBackend::AUTO))
+		return MediaBackend::WAV;
+	return choose_media_backend(url, av::MediaReader{url}, with_video);
+}
+
+MediaBackend choose_media_backend(const std::string &url, const av::MediaReader &format, const bool with_video)
+{
+	if (with_video)
+		try
+		{
+			if (!(format.find_best_stream(AVMEDIA_TYPE_VIDEO)->disposition & AV_DISPOSITION_ATTACHED_PIC))
+				return MediaBackend::FFMPEG_BOOST;
+		}
+		catch (const av::Error &)
+		{
+			// no video stream
+		}
+
+	const auto codec_id = format.find_best_stream(AVMEDIA_TYPE_AUDIO)->codecpar->codec_id;
+	// all raw pcm codec ids are in this block
+	const bool pcm = codec_id >= AV_CODEC_ID_FIRST_AUDIO && codec_id < AV_CODEC_ID_ADPCM_IMA_QT;
+	if (pcm && !url.contains("://"))
+		return MediaBackend::LIBAV;
+
+	return MediaBackend::FFMPEG_BOOST;
+}
+
+// opens a source that comes with its probe, with any backend but `WAV`
+static std::unique_ptr<Media> create_probed_media(
+	const Media::Source &source,
+	const sf::Vector2u video_size,
+	MediaBackend backend,
+	const FfmpegCliMedia::PcmFormat pcm_format,
+	const int max_video_fps,
+	const std::string &video_filter,
+	const bool yuv_video)
+{
+	if (backend == MediaBackend::AUTO)
+		backend = choose_media_backend(source.url, *source.probe, video_size.x && video_size.y);
+
+	switch (backend)
+	{
+	case MediaBackend::LIBAV:
+		return std::make_unique<LibavMedia>(source, video_size, max_video_fps);
+	case MediaBackend::FFMPEG_BOOST:
+		return std::make_unique<FfmpegCliBoostMedia>(
+			source, video_size, pcm_format, max_video_fps, video_filter, yuv_video);
+	case MediaBackend::FFMPEG_POPEN:
+		return std::make_unique<FfmpegCliPopenMedia>(
+			source, video_size, pcm_format, max_video_fps, video_filter, yuv_video);
+	default:
+		throw std::logic_error{"unknown media backend"};
+	}
+}
+
+std::unique_ptr<Media> create_media(
+	const std::string &url,
+	const sf::Vector2u video_size,
+	const MediaBackend backend,
+	const FfmpegCliMedia::PcmFormat pcm_format,
+	const int max_video_fps,
+	const std::string &video_filter,
+	const bool yuv_video)
+{
+	if (opens_as_wav(url, backend))
+		return std::make_unique<WavMedia>(url);
+	// probed once here; picking the backend and the media itself share it
+	return create_probed_media(
+		{url, std::make_shared<av::MediaReader>(url)},
+		video_size,
+		backend,
+		pcm_format,
+		max_video_fps,
+		video_filter,
+		yuv_video);
+}
+
+std::unique_ptr<Media> create_media(
+	const std::string &url,
+	const sf::Vector2u video_size,
+	const MediaBackend backend,
+	const FfmpegCliMedia::PcmFormat pcm_format,
+	const int max_video_fps,
+	const std::string &video_filter,
+	const bool yuv_video,
+	const PcmCache &cache)
+{
+	if (opens_as_wav(url, backend))
+		return std::make_unique<WavMedia>(url);
+
+	// probed once here; the cache key, picking the backend and the media itself share it
+	const Media::Source source{url, std::make_shared<av::MediaReader>(url)};
+	const auto key = PcmCache::key(source, video_size.x && video_size.y);
+	if (!key)
+		return create_probed_media(source, video_size, backend, pcm_format, max_video_fps, video_filter, yuv_video);
+
+	if (const auto path = cache.find(*key))
+		try
+		{
+			return std::make_unique<WavMedia>(path->string(), source);
+		}
+		catch (const std::runtime_error &e)
+		{
+			// e.g. another process evicted it just now; decode and cache it again
+			std::cerr << e.what() << '\n';
+		}
+
+	return std::make_unique<PcmCacheMedia>(
+		create_probed_media(source, video_size, backend, pcm_format, max_video_fps, video_filter, yuv_video),
+		cache,
+		*key);
+}
@@ -0,0 +1,277 @@
+#include "media/PcmCache.hpp"
+#include "media/WavMedia.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+extern "C"
+{
+#include <libavutil/channel_layout.h>
+}
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// header of an entry: RIFF, a JUNK chunk that becomes RF64's ds64 chunk if the data outgrows 4 GiB, a float
+// fmt chunk and the data chunk header. 80 bytes, so the samples are aligned for `WavMedia` to use them in place
+static constexpr size_t junk_offset = 12, fmt_offset = 48, data_offset = 72, header_size = 80;
+
+template <typename T>
+static void put_le(std::byte *const dst, const T value)
+{
+	// wav is little-endian, and so is every platform we build for
+	std::memcpy(dst, &value, sizeof(T));
+}
+
+// a fast, non-cryptographic 64-bit hash; the four lanes keep several multiplies in flight
+static uint64_t hash_bytes(const std::span<const std::byte> bytes)
+{
+	constexpr uint64_t p1 = 0x9E3779B185EBCA87, p2 = 0xC2B2AE3D27D4EB4F;
+	const auto round = [&](uint64_t acc, const uint64_t word)
+	{
+		acc += word * p2;
+		acc = (acc << 31) | (acc >> 33);
+		return acc * p1;
+	};
+
+	uint64_t lanes[4]{p1 + p2, p2, 0, -p1};
+	size_t i = 0;
+	for (; i + 32 <= bytes.size(); i += 32)
+		for (int l = 0; l < 4; ++l)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes.data() + i + 8 * l, 8);
+			lanes[l] = round(lanes[l], word);
+		}
+
+	uint64_t h = bytes.size() * p1;
+	for (const auto lane : lanes)
+		h = round(h ^ lane, lane);
+	for (; i < bytes.size(); ++i)
+		h = round(h, (uint64_t)bytes[i]);
+
+	// final avalanche
+	h ^= h >> 33;
+	h *= p2;
+	h ^= h >> 29;
+	return h;
+}
+
+PcmCache::PcmCache(const fs::path &dir, const uintmax_t max_bytes)
+	: dir{dir},
+	  max_bytes{max_bytes}
+{
+	fs::create_directories(dir);
+}
+
+std::optional<std::string> PcmCache::key(const Media::Source &source, const bool with_video)
+{
+	const auto &url = source.url;
+	if (url.contains("://") || !fs::is_regular_file(url) || WavMedia::is_supported(url))
+		return {};
+
+	const auto reader = source.probe ? source.probe : std::make_shared<av::MediaReader>(url);
+	if (with_video)
+		try
+		{
+			if (!(reader->find_best_stream(AVMEDIA_TYPE_VIDEO)->disposition & AV_DISPOSITION_ATTACHED_PIC))
+				return {};
+		}
+		catch (const av::Error &)
+		{
+			// no video stream
+		}
+
+	const auto codecpar = reader->find_best_stream(AVMEDIA_TYPE_AUDIO)->codecpar;
+	char layout[64];
+	av_channel_layout_describe(&codecpar->ch_layout, layout, sizeof(layout));
+
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)hash_bytes(WavMedia::MappedFile{url}.bytes()));
+
+	// layout names like "5.1(side)" are fine in file names, but play it safe
+	std::string key = std::string{hash} + '-' + std::to_string(codecpar->sample_rate) + '-' + layout;
+	std::ranges::replace_if(key, [](const char c) { return !std::isalnum((unsigned char)c) && c != '-' && c != '.'; }, '_');
+	return key;
+}
+
+fs::path PcmCache::entry_path(const std::string &key) const
+{
+	return dir / (key + ".wav");
+}
+
+std::optional<fs::path> PcmCache::find(const std::string &key) const
+{
+	const auto path = entry_path(key);
+	std::error_code ec;
+	if (!fs::is_regular_file(path, ec))
+		return {};
+
+	// eviction goes by modification time
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	return path;
+}
+
+void PcmCache::evict() const
+{
+#ifndef _WIN32
+	// serializes evicting processes; released when closed.
+	// on windows files in use can't be deleted anyway, so concurrent evictions only fail to remove some files
+	const int lock = open((dir / ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (lock >= 0)
+		flock(lock, LOCK_EX);
+#endif
+
+	struct Entry
+	{
+		fs::path path;
+		fs::file_time_type time;
+		uintmax_t size;
+	};
+	std::vector<Entry> entries;
+	uintmax_t total{};
+
+	std::error_code ec;
+	const auto now = fs::file_time_type::clock::now();
+	for (const auto &file : fs::directory_iterator{dir, ec})
+	{
+		const auto time = file.last_write_time(ec);
+		if (ec)
+			continue;
+		if (file.path().extension() == ".tmp")
+		{
+			// a writer is long gone if its file hasn't changed in a day
+			if (now - time > std::chrono::hours{24})
+				fs::remove(file.path(), ec);
+		}
+		else if (file.path().extension() == ".wav")
+		{
+			const auto size = file.file_size(ec);
+			if (ec)
+				continue;
+			entries.push_back({file.path(), time, size});
+			total += size;
+		}
+	}
+
+	std::ranges::sort(entries, {}, &Entry::time);
+	for (const auto &entry : entries)
+	{
+		if (total <= max_bytes)
+			break;
+		if (fs::remove(entry.path, ec))
+			total -= entry.size;
+	}
+
+#ifndef _WIN32
+	if (lock >= 0)
+		close(lock);
+#endif
+}
+
+PcmCache::Writer::Writer(const PcmCache &cache, const std::string &key, const int sample_rate, const int nb_channels)
+	: cache{cache},
+	  // unique among concurrent writers of the same key, in this and other processes
+	  tmp_path{cache.dir / [&]
+			   {
+				   static std::atomic<int> counter;
+				   return key + '.' + std::to_string(getpid()) + '.' + std::to_string(counter++) + ".tmp";
+			   }()},
+	  final_path{cache.entry_path(key)},
+	  nb_channels{nb_channels},
+	  out{tmp_path, std::ios::binary}
+{
+	if (!out)
+		throw std::runtime_error{"PcmCache: can't create " + tmp_path.string()};
+
+	std::byte header[header_size]{};
+	std::memcpy(header, "RIFF", 4);
+	std::memcpy(header + 8, "WAVE", 4);
+	std::memcpy(header + junk_offset, "JUNK", 4);
+	put_le<uint32_t>(header + junk_offset + 4, fmt_offset - junk_offset - 8);
+	std::memcpy(header + fmt_offset, "fmt ", 4);
+	put_le<uint32_t>(header + fmt_offset + 4, 16);
+	put_le<uint16_t>(header + fmt_offset + 8, 3); // WAVE_FORMAT_IEEE_FLOAT
+	put_le<uint16_t>(header + fmt_offset + 10, nb_channels);
+	put_le<uint32_t>(header + fmt_offset + 12, sample_rate);
+	put_le<uint32_t>(header + fmt_offset + 16, sample_rate * nb_channels * sizeof(float));
+	put_le<uint16_t>(header + fmt_offset + 20, nb_channels * sizeof(float));
+	put_le<uint16_t>(header + fmt_offset + 22, 32);
+	std::memcpy(header + data_offset, "data", 4);
+	// sizes are filled in by `commit()`
+	out.write(reinterpret_cast<const char *>(header), header_size);
+}
+
+PcmCache::Writer::~Writer()
+{
+	if (committed)
+		return;
+	out.close();
+	std::error_code ec;
+	fs::remove(tmp_path, ec);
+}
+
+void PcmCache::Writer::write(const float *const *const planes, const int frames)
+{
+	const auto samples = (size_t)frames * nb_channels;
+	if (interleaved.size() < samples)
+		interleaved.resize(samples);
+	for (int c = 0; c < nb_channels; ++c)
+		for (int i = 0; i < frames; ++i)
+			interleaved[i * nb_channels + c] = planes[c][i];
+
+	out.write(reinterpret_cast<const char *>(interleaved.data()), samples * sizeof(float));
+	if (!out)
+		throw std::runtime_error{"PcmCache: can't write " + tmp_path.string()};
+	data_bytes += samples * sizeof(float);
+}
+
+void PcmCache::Writer::commit()
+{
+	const uint64_t riff_size = header_size - 8 + data_bytes;
+	if (riff_size <= UINT32_MAX)
+	{
+		std::byte size[4];
+		put_le<uint32_t>(size, riff_size);
+		out.seekp(4).write(reinterpret_cast<const char *>(size), 4);
+		put_le<uint32_t>(size, data_bytes);
+		out.seekp(data_offset + 4).write(reinterpret_cast<const char *>(size), 4);
+	}
+	else
+	{
+		// too big for riff: becomes rf64, with the real sizes in the ds64 chunk that replaces JUNK
+		std::byte riff[8], ds64[8 + 28]{}, data_size[4];
+		std::memcpy(riff, "RF64", 4);
+		put_le<uint32_t>(riff + 4, UINT32_MAX);
+		std::memcpy(ds64, "ds64", 4);
+		put_le<uint32_t>(ds64 + 4, 28);
+		put_le<uint64_t>(ds64 + 8, riff_size);
+		put_le<uint64_t>(ds64 + 16, data_bytes);
+		put_le<uint64_t>(ds64 + 24, data_bytes / (nb_channels * sizeof(float)));
+		put_le<uint32_t>(data_size, UINT32_MAX);
+		out.seekp(0).write(reinterpret_cast<const char *>(riff), sizeof(riff));
+		out.seekp(junk_offset).write(reinterpret_cast<const char *>(ds64), sizeof(ds64));
+		out.seekp(data_offset + 4).write(reinterpret_cast<const char *>(data_size), sizeof(data_size));
+	}
+
+	out.close();
+	if (!out)
+		throw std::runtime_error{"PcmCache: can't write " + tmp_path.string()};
+
+	// atomic: readers see either no entry or a complete one
+	fs::rename(tmp_path, final_path);
+	committed = true;
+	cache.evict();
+}
@@ -0,0 +1,63 @@
+#include "media/PcmCacheMedia.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+PcmCacheMedia::PcmCacheMedia(std::unique_ptr<Media> _inner, const PcmCache &cache, const std::string &key)
+	: Media{*_inner, _inner->video_size},
+	  inner{std::move(_inner)}
+{
+	writer.emplace(cache, key, _sample_rate, _nb_channels);
+}
+
+void PcmCacheMedia::decode_audio(const int frames)
+{
+	if (_audio_buffer.frames() >= frames)
+		return;
+
+	// everything `inner` decodes passes through here, so its buffer is empty before this
+	inner->decode_audio(frames - _audio_buffer.frames());
+	const auto &audio = inner->audio_buffer();
+	if (const auto count = audio.frames())
+	{
+		write_audio(audio.channels(), count);
+		if (writer)
+			try
+			{
+				writer->write(audio.channels(), count);
+			}
+			catch (const std::runtime_error &e)
+			{
+				// not worth failing the render over
+				std::cerr << e.what() << ", not caching this media\n";
+				writer.reset();
+			}
+		inner->audio_buffer_erase(count);
+	}
+
+	// `inner` decoded less than asked for, so it reached the end
+	if (_audio_buffer.frames() < frames && writer)
+	{
+		try
+		{
+			writer->commit();
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << e.what() << ", not caching this media\n";
+		}
+		writer.reset();
+	}
+}
+
+void PcmCacheMedia::seek(const double seconds)
+{
+	writer.reset();
+	inner->seek(seconds);
+	_audio_buffer.clear();
+}
+
+size_t PcmCacheMedia::read_audio_samples(float *, int)
+{
+	throw std::logic_error{"PcmCacheMedia: raw audio reads would bypass the cache; use decode_audio"};
+}
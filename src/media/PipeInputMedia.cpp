@@ -0,0 +1,103 @@
+#ifndef _WIN32
+
+#include "media/PipeInputMedia.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <system_error>
+#include <unistd.h>
+
+PipeInputMedia::PipeInputMedia(
+	const std::string &url, const int fd, const int sample_rate, const int nb_channels, const int block_frames)
+	: LiveMedia{url, sample_rate, nb_channels, block_frames},
+	  fd{fd}
+{
+#ifdef LINUX
+	// the kernel rounds up to a page; failing (e.g. not a pipe) is fine
+	fcntl(fd, F_SETPIPE_SZ, block_frames * nb_channels * (int)sizeof(float));
+#endif
+	reader = std::jthread{[this](const std::stop_token st) { read_blocks(st); }};
+}
+
+PipeInputMedia::~PipeInputMedia()
+{
+	reader.request_stop();
+	signal_progress();
+}
+
+bool PipeInputMedia::read_fully(const std::stop_token &st, std::byte *const buf, const size_t bytes, size_t &filled)
+{
+	filled = 0;
+	while (filled < bytes)
+	{
+		// wake up now and then to check for stop requests; a blocked `read` couldn't
+		pollfd pfd{fd, POLLIN, 0};
+		if (poll(&pfd, 1, 50) < 0 && errno != EINTR)
+			throw std::system_error{errno, std::generic_category(), "poll"};
+		if (st.stop_requested())
+			return false;
+		if (!pfd.revents)
+			continue;
+
+		const auto n = read(fd, buf + filled, bytes - filled);
+		if (n < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			throw std::system_error{errno, std::generic_category(), "read"};
+		}
+		if (!n)
+			break;
+		filled += n;
+	}
+	return true;
+}
+
+void PipeInputMedia::read_blocks(const std::stop_token st)
+{
+	const auto frame_bytes = _nb_channels * sizeof(float);
+	try
+	{
+		while (true)
+		{
+			// read before checking anything: any pop after this, or the destructor, wakes the wait below
+			const auto seen = _progress.load();
+			if (st.stop_requested())
+				return;
+			const auto block = _blocks.back();
+			if (!block)
+			{
+				// the consumer is behind; waiting holds back the writer too
+				_progress.wait(seen);
+				continue;
+			}
+
+			size_t filled;
+			if (!read_fully(st, reinterpret_cast<std::byte *>(block->samples.data()), block->samples.size() * sizeof(float), filled))
+				return;
+
+			// an incomplete frame at the very end is dropped
+			block->frames = filled / frame_bytes;
+			if (block->frames)
+			{
+				// the last frame just arrived; the first one is a block's duration older
+				block->captured = Clock::now() - std::chrono::duration_cast<Clock::duration>(
+													 std::chrono::duration<double>((double)block->frames / _sample_rate));
+				_blocks.push();
+				signal_progress();
+			}
+
+			if (filled < block->samples.size() * sizeof(float))
+				break;
+		}
+	}
+	catch (...)
+	{
+		_error = std::current_exception();
+	}
+	_eof = true;
+	signal_progress();
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef _WIN32
+
+#include "media/PipePump.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+PipePump::PipePump(const int fd, const size_t max_bytes)
+	: fd{fd},
+	  max_bytes{max_bytes}
+{
+	if (pipe(stop_pipe) == -1)
+		throw std::system_error{errno, std::generic_category(), "pipe"};
+	thread = std::jthread{[this](const std::stop_token st) { work(st); }};
+}
+
+PipePump::~PipePump()
+{
+	thread.request_stop();
+	::write(stop_pipe[1], "", 1);
+	thread.join();
+	::close(stop_pipe[0]);
+	::close(stop_pipe[1]);
+}
+
+void PipePump::work(const std::stop_token st)
+{
+	std::vector<std::byte> chunk(1 << 16);
+	try
+	{
+		while (true)
+		{
+			{ // wait for room
+				std::unique_lock lock{mutex};
+				if (!cv.wait(lock, st, [&] { return buffer.size() - begin < max_bytes; }))
+					return;
+			}
+
+			pollfd fds[]{{fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+			if (poll(fds, 2, -1) == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::system_error{errno, std::generic_category(), "poll"};
+			}
+			if (fds[1].revents)
+				return;
+
+			const auto bytes_read = ::read(fd, chunk.data(), chunk.size());
+			if (bytes_read == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::system_error{errno, std::generic_category(), "read"};
+			}
+
+			const std::lock_guard lock{mutex};
+			if (!bytes_read)
+			{
+				eof = true;
+				cv.notify_all();
+				return;
+			}
+			buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + bytes_read);
+			cv.notify_all();
+		}
+	}
+	catch (...)
+	{
+		const std::lock_guard lock{mutex};
+		error = std::current_exception();
+		eof = true;
+		cv.notify_all();
+	}
+}
+
+size_t PipePump::read(void *const buf, const size_t bytes)
+{
+	std::unique_lock lock{mutex};
+	cv.wait(lock, [&] { return buffer.size() > begin || eof; });
+
+	const auto n = std::min(bytes, buffer.size() - begin);
+	if (!n)
+	{
+		if (error)
+			std::rethrow_exception(std::exchange(error, nullptr));
+		return 0;
+	}
+
+	std::memcpy(buf, buffer.data() + begin, n);
+	begin += n;
+
+	// move the rest to the front once it's cheap enough, so the buffer doesn't grow forever
+	if (begin == buffer.size())
+		buffer.clear(), begin = 0;
+	else if (begin > buffer.size() / 2)
+	{
+		buffer.erase(buffer.begin(), buffer.begin() + begin);
+		begin = 0;
+	}
+
+	// the pump might be waiting for room
+	cv.notify_all();
+	return n;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "media/PlaylistMedia.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+std::unique_ptr<Media> PlaylistMedia::open_first(const std::vector<std::string> &urls, const Opener &open)
+{
+	if (urls.empty())
+		throw std::invalid_argument{"PlaylistMedia: no tracks"};
+	return open(urls.front(), 0, 0);
+}
+
+PlaylistMedia::PlaylistMedia(
+	const std::vector<std::string> &urls, const Opener &open, const int preload_frames, const bool skip_failed)
+	: PlaylistMedia{urls, open, preload_frames, skip_failed, open_first(urls, open)}
+{
+}
+
+PlaylistMedia::PlaylistMedia(
+	const std::vector<std::string> &urls,
+	const Opener &open,
+	const int preload_frames,
+	const bool skip_failed,
+	std::unique_ptr<Media> first)
+	: Media{*first, {}},
+	  urls{urls},
+	  open{open},
+	  preload_frames{preload_frames},
+	  skip_failed{skip_failed},
+	  current{std::move(first)}
+{
+	// the first track's video stream would be mistaken for the playlist's
+	_vstream.reset();
+	_video_frame_rate = {0, 1};
+	_video_filter.clear();
+	_video_format = VideoFormat::RGBA;
+
+	load_after(0);
+	prober = std::jthread{[this](const std::stop_token st) { probe_durations(st); }};
+}
+
+void PlaylistMedia::probe_durations(const std::stop_token st)
+{
+	double total{};
+	for (const auto &url : urls)
+	{
+		if (st.stop_requested())
+			return;
+		try
+		{
+			// only reads the header, nothing is decoded
+			const av::MediaReader reader{url};
+			const auto duration = reader->duration;
+			if (duration == AV_NOPTS_VALUE || duration <= 0)
+				return;
+			total += (double)duration / AV_TIME_BASE;
+		}
+		catch (const std::exception &)
+		{
+			// e.g. raw samples; the loader reports tracks that really can't be opened
+			return;
+		}
+	}
+	total_duration = total;
+}
+
+void PlaylistMedia::load_after(const size_t index)
+{
+	loader = std::jthread{
+		[this, index](const std::stop_token st)
+		{
+			for (auto i = index + 1; i < urls.size() && !st.stop_requested(); ++i)
+				try
+				{
+					auto media = open(urls[i], _sample_rate, _nb_channels);
+					if (media->sample_rate() != _sample_rate || media->nb_channels() != _nb_channels)
+						throw std::runtime_error{
+							"decodes to " + std::to_string(media->sample_rate()) + " Hz, " +
+							std::to_string(media->nb_channels()) + " channels instead of " +
+							std::to_string(_sample_rate) + " Hz, " + std::to_string(_nb_channels)};
+					// so that the switch doesn't wait for e.g. ffmpeg starting up
+					media->decode_audio(preload_frames);
+					next = std::move(media);
+					next_index = i;
+					return;
+				}
+				catch (const std::exception &e)
+				{
+					if (!skip_failed)
+					{
+						load_error = std::make_exception_ptr(
+							std::runtime_error{"playlist: can't play '" + urls[i] + "': " + e.what()});
+						return;
+					}
+					std::cerr << "playlist: skipping '" << urls[i] << "': " << e.what() << '\n';
+				}
+		}};
+}
+
+bool PlaylistMedia::next_track()
+{
+	if (loader.joinable())
+		loader.join();
+	if (load_error)
+		std::rethrow_exception(std::exchange(load_error, nullptr));
+	if (!next)
+		return false;
+
+	previous = std::move(current);
+	previous_index = current_index;
+	current = std::move(next);
+	current_index = next_index;
+	current_start = frames_written;
+
+	load_after(current_index);
+	return true;
+}
+
+void PlaylistMedia::decode_audio(const int frames)
+{
+	while (_audio_buffer.frames() < frames)
+	{
+		// everything `current` decodes is copied on, so its buffer is empty before this
+		current->decode_audio(frames - _audio_buffer.frames());
+		const auto &audio = current->audio_buffer();
+		if (const auto count = audio.frames())
+		{
+			write_audio(audio.channels(), count);
+			current->audio_buffer_erase(count);
+			frames_written += count;
+		}
+
+		// `current` decoded less than asked for, so it reached the end
+		if (_audio_buffer.frames() < frames && !next_track())
+			break;
+	}
+
+	// the previous track is over once none of its audio is left in the buffer
+	if (previous && frames_written - _audio_buffer.frames() >= current_start)
+		previous.reset();
+	_track = previous ? previous_index : current_index;
+}
+
+std::optional<double> PlaylistMedia::duration() const
+{
+	if (const auto duration = total_duration.load(); duration >= 0)
+		return duration;
+	return {};
+}
+
+std::optional<std::string> PlaylistMedia::metadata(const std::string &key) const
+{
+	return playing().metadata(key);
+}
+
+const std::optional<sf::Texture> &PlaylistMedia::attached_pic() const
+{
+	return playing().attached_pic();
+}
+
+size_t PlaylistMedia::read_audio_samples(float *, int)
+{
+	throw std::logic_error{"PlaylistMedia: raw audio reads can't cross tracks; use decode_audio"};
+}
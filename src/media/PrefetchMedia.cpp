@@ -0,0 +1,240 @@
+#include "media/PrefetchMedia.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+PrefetchMedia::PrefetchMedia(
+	std::unique_ptr<Media> _inner, const int audio_blocks, const int block_frames, const int video_frames)
+	: Media{*_inner, _inner->video_size},
+	  inner{std::move(_inner)},
+	  block_frames{block_frames},
+	  // allocate every buffer up front; the queues reuse their elements
+	  audio_queue{audio_blocks, {std::vector<float>(block_frames * _nb_channels)}},
+	  video_queue{video_frames, {std::vector<uint8_t>(video_frame_bytes())}},
+	  planes(_nb_channels)
+{
+	if (audio_blocks <= 0 || block_frames <= 0 || video_frames <= 0)
+		throw std::invalid_argument{"PrefetchMedia: readahead depths and block size must be positive"};
+
+	start_worker();
+}
+
+void PrefetchMedia::start_worker()
+{
+	worker = std::jthread{[this](const std::stop_token st) { work(st); }};
+}
+
+PrefetchMedia::~PrefetchMedia()
+{
+	worker.request_stop();
+	signal_progress();
+}
+
+void PrefetchMedia::signal_progress()
+{
+	++progress;
+	progress.notify_all();
+}
+
+void PrefetchMedia::wait_for_progress(const uint32_t seen)
+{
+	++_underruns;
+	progress.wait(seen);
+}
+
+void PrefetchMedia::rethrow_error()
+{
+	if (error)
+		std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void PrefetchMedia::work(const std::stop_token st)
+{
+	try
+	{
+		while (true)
+		{
+			// read before checking anything: any pop after this, or the destructor, wakes the wait below
+			const auto seen = progress.load();
+			if (st.stop_requested())
+				return;
+			const auto did_audio = prefetch_audio();
+			const auto did_video = prefetch_video();
+			if (did_audio || did_video)
+				signal_progress();
+			else
+				// queues are full, or everything was read
+				progress.wait(seen);
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+		audio_eof = video_eof = true;
+		signal_progress();
+	}
+}
+
+bool PrefetchMedia::prefetch_audio()
+{
+	if (audio_eof)
+		return false;
+	const auto block = audio_queue.back();
+	if (!block)
+		return false;
+
+	inner->decode_audio(block_frames);
+	const auto &audio = inner->audio_buffer();
+	block->frames = std::min(block_frames, audio.frames());
+	if (!block->frames)
+	{
+		audio_eof = true;
+		return true;
+	}
+
+	for (int c = 0; c < audio.num_channels(); ++c)
+		std::ranges::copy(audio.channel(c).first(block->frames), block->samples.begin() + c * block_frames);
+	inner->audio_buffer_erase(block->frames);
+	audio_queue.push();
+	return true;
+}
+
+bool PrefetchMedia::prefetch_video()
+{
+	if (!_vstream || !video_size.x || !video_size.y || video_eof)
+		return false;
+	const auto frame = video_queue.back();
+	if (!frame)
+		return false;
+
+	if (inner->read_video_frame(frame->pixels))
+	{
+		frame->time = inner->video_frame_time();
+		video_queue.push();
+	}
+	else
+		video_eof = true;
+	return true;
+}
+
+void PrefetchMedia::seek(const double seconds)
+{
+	worker.request_stop();
+	signal_progress();
+	worker.join();
+
+	// with the worker stopped, this thread may act as both producer and consumer of the queues
+	while (audio_queue.front())
+		audio_queue.pop();
+	while (video_queue.front())
+		video_queue.pop();
+	audio_eof = video_eof = false;
+	error = nullptr;
+	_audio_buffer.clear();
+
+	// restart even if seeking fails, so that the media keeps playing from wherever it is
+	try
+	{
+		inner->seek(seconds);
+	}
+	catch (...)
+	{
+		start_worker();
+		throw;
+	}
+	start_worker();
+}
+
+void PrefetchMedia::decode_audio(const int frames)
+{
+	while (_audio_buffer.frames() < frames)
+	{
+		const auto seen = progress.load();
+		if (const auto block = audio_queue.front())
+		{
+			for (int c = 0; c < (int)planes.size(); ++c)
+				planes[c] = block->samples.data() + c * block_frames;
+			write_audio(planes.data(), block->frames);
+			audio_queue.pop();
+			signal_progress();
+			continue;
+		}
+
+		// the background thread sets `audio_eof` after its last push, so check the queue once more
+		if (audio_eof)
+		{
+			if (audio_queue.front())
+				continue;
+			rethrow_error();
+			return;
+		}
+
+		wait_for_progress(seen);
+	}
+}
+
+bool PrefetchMedia::read_video_frame(const std::span<uint8_t> pixels)
+{
+	while (true)
+	{
+		const auto seen = progress.load();
+		if (const auto frame = video_queue.front())
+		{
+			if (pixels.size() < frame->pixels.size())
+				throw std::invalid_argument{"read_video_frame: buffer too small for one frame"};
+			std::ranges::copy(frame->pixels, pixels.begin());
+			_video_frame_time = frame->time;
+			video_queue.pop();
+			signal_progress();
+			return true;
+		}
+
+		if (video_eof)
+		{
+			if (video_queue.front())
+				continue;
+			rethrow_error();
+			return false;
+		}
+
+		wait_for_progress(seen);
+	}
+}
+
+bool PrefetchMedia::read_video_frame(sf::Texture &txr)
+{
+	if (_video_format != VideoFormat::RGBA)
+		throw std::logic_error{"read_video_frame: yuv frames can't be uploaded as rgba"};
+	if (!txr.resize(video_size))
+		throw std::runtime_error{"texture resize failed!"};
+
+	// upload straight from the queue instead of copying the frame out first
+	while (true)
+	{
+		const auto seen = progress.load();
+		if (const auto frame = video_queue.front())
+		{
+			txr.update(frame->pixels.data());
+			_video_frame_time = frame->time;
+			video_queue.pop();
+			signal_progress();
+			return true;
+		}
+
+		if (video_eof)
+		{
+			if (video_queue.front())
+				continue;
+			rethrow_error();
+			return false;
+		}
+
+		wait_for_progress(seen);
+	}
+}
+
+size_t PrefetchMedia::read_audio_samples(float *, int)
+{
+	throw std::logic_error{"PrefetchMedia: raw audio reads would bypass the prefetched audio; use decode_audio"};
+}
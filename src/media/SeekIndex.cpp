@@ -0,0 +1,166 @@
+#include "media/SeekIndex.hpp"
+
+#include <av/MediaReader.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// keyframes closer together than this (e.g. every audio packet, or all-intra video) are thinned out
+static constexpr double min_spacing = 0.25;
+
+static fs::path cache_dir()
+{
+	if (const auto xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg)
+		return fs::path{xdg} / "audioviz" / "seek-index";
+	if (const auto home = getenv("HOME"))
+		return fs::path{home} / ".cache" / "audioviz" / "seek-index";
+	return {};
+}
+
+// identifies the file's current contents well enough, without reading them
+static std::string file_stamp(const fs::path &path)
+{
+	return std::to_string(fs::file_size(path)) + ' ' +
+		   std::to_string(fs::last_write_time(path).time_since_epoch().count());
+}
+
+static void thin_out(std::vector<double> &times)
+{
+	std::ranges::sort(times);
+	std::vector<double> kept;
+	for (const auto time : times)
+		if (kept.empty() || time - kept.back() >= min_spacing)
+			kept.push_back(time);
+	times = std::move(kept);
+}
+
+SeekIndex::SeekIndex(const std::string &url, const bool video, const std::stop_token &st)
+{
+	std::error_code ec;
+	if (url.contains("://") || !fs::is_regular_file(url, ec))
+		return;
+
+	try
+	{
+		av::MediaReader reader{url};
+
+		auto stream = reader.find_best_stream(AVMEDIA_TYPE_AUDIO);
+		if (video)
+			try
+			{
+				if (const auto s = reader.find_best_stream(AVMEDIA_TYPE_VIDEO); !(s->disposition & AV_DISPOSITION_ATTACHED_PIC))
+					stream = s;
+			}
+			catch (const av::Error &)
+			{
+				// no video stream
+			}
+
+		const auto indexed = stream.get();
+		const auto start = (indexed->start_time == AV_NOPTS_VALUE) ? 0 : indexed->start_time;
+		const auto to_seconds = [&](const int64_t ts) { return (ts - start) * av_q2d(indexed->time_base); };
+
+		// the demuxer may have read an index along with the header
+		for (int i = 0; i < avformat_index_get_entries_count(indexed); ++i)
+			if (const auto entry = avformat_index_get_entry(indexed, i); entry->flags & AVINDEX_KEYFRAME)
+				_times.push_back(to_seconds(entry->timestamp));
+		if (!_times.empty())
+		{
+			thin_out(_times);
+			return;
+		}
+
+		const auto dir = cache_dir();
+		const auto stamp = file_stamp(url);
+		const auto file = dir.empty() ? fs::path{}
+									  : dir / (std::to_string(std::hash<std::string>{}(fs::absolute(url).string())) +
+											   '-' + std::to_string(indexed->index));
+
+		if (std::ifstream in{file}; in)
+		{
+			std::string line;
+			if (std::getline(in, line) && line == stamp)
+			{
+				for (double time; in >> time;)
+					_times.push_back(time);
+				return;
+			}
+		}
+
+		// only the indexed stream's packets are of interest; the rest aren't even read into packets
+		for (const auto &s : reader.streams())
+			if (s->index != indexed->index)
+				s->discard = AVDISCARD_ALL;
+		while (const auto packet = reader.read_packet())
+		{
+			if (st.stop_requested())
+			{
+				_times.clear();
+				return;
+			}
+			if (packet->stream_index == indexed->index && (packet->flags & AV_PKT_FLAG_KEY))
+				if (const auto ts = (packet->pts == AV_NOPTS_VALUE) ? packet->dts : packet->pts; ts != AV_NOPTS_VALUE)
+					_times.push_back(to_seconds(ts));
+		}
+		thin_out(_times);
+
+		if (file.empty())
+			return;
+		// written to a temporary file and renamed into place, so that concurrent runs never see half an index
+		fs::create_directories(dir, ec);
+		// unique among concurrent writers of the same index, in this and other processes
+		static std::atomic<int> counter;
+		const auto tmp = fs::path{file} += '.' + std::to_string(getpid()) + '.' + std::to_string(counter++) + ".tmp";
+		{
+			std::ofstream out{tmp};
+			// exact round trips, so snapping lands on the same times as a fresh scan
+			out.precision(17);
+			out << stamp << '\n';
+			for (const auto time : _times)
+				out << time << '\n';
+			if (!out)
+			{
+				out.close();
+				fs::remove(tmp, ec);
+				return;
+			}
+		}
+		if (fs::rename(tmp, file, ec); ec)
+			fs::remove(tmp, ec);
+	}
+	catch (const std::exception &e)
+	{
+		// seeking still works, just without snapping to keyframes
+		std::cerr << "seek index: " << e.what() << '\n';
+		_times.clear();
+	}
+}
+
+std::optional<double> SeekIndex::at_or_before(const double time) const
+{
+	const auto itr = std::ranges::upper_bound(_times, time);
+	if (itr == _times.begin())
+		return {};
+	return *std::prev(itr);
+}
+
+std::optional<double> SeekIndex::at_or_after(const double time) const
+{
+	const auto itr = std::ranges::lower_bound(_times, time);
+	if (itr == _times.end())
+		return {};
+	return *itr;
+}
@@ -0,0 +1,180 @@
+#include "media/VideoScalePath.hpp"
+
+#ifdef LINUX
+#include <boost/process.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <unistd.h>
+
+namespace bp = boost::process;
+namespace fs = std::filesystem;
+#endif
+
+std::vector<std::string> VideoScalePath::args(
+	const sf::Vector2u size, const std::string &pre_filter, const std::string &post_filter) const
+{
+	const auto w = std::to_string(size.x), h = std::to_string(size.y);
+	const auto pre = pre_filter.empty() ? "" : pre_filter + ',';
+	const auto post = post_filter.empty() ? "" : ',' + post_filter;
+	if (vaapi_device.empty())
+		return {"-vf", pre + "scale=" + w + ':' + h + ":flags=" + software_flags + post};
+	return {
+		"-vaapi_device",
+		vaapi_device,
+		// va-api hardware accelerated scaling!
+		"-vf",
+		pre + "format=nv12,hwupload,scale_vaapi=" + w + ':' + h + ",hwdownload,format=nv12" + post,
+	};
+}
+
+#ifdef LINUX
+
+// seconds ffmpeg takes to scale a few seconds of generated 1080p video, or nothing if the path doesn't work
+static std::optional<double> benchmark(const VideoScalePath &path)
+{
+	std::vector<std::string> args{"-v", "error", "-f", "lavfi", "-i", "testsrc2=size=1920x1080:rate=30", "-frames:v", "90"};
+	const auto path_args = path.args({1280, 720});
+	args.insert(args.end(), path_args.begin(), path_args.end());
+	args.insert(args.end(), {"-pix_fmt", "rgba", "-f", "null", "-"});
+
+	const auto start = std::chrono::steady_clock::now();
+	try
+	{
+		bp::child ffmpeg{bp::search_path("ffmpeg"), args, bp::std_out > bp::null, bp::std_err > bp::null};
+		ffmpeg.wait();
+		if (ffmpeg.exit_code())
+			return {};
+	}
+	catch (const bp::process_error &)
+	{
+		return {};
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct ProbeResult
+{
+	VideoScalePath best;
+	// every render node that scaled, fastest or not
+	std::vector<std::string> vaapi_devices;
+};
+
+// the fastest working candidate and the working render nodes, or nothing if none work (e.g. no ffmpeg in PATH)
+static std::optional<ProbeResult> probe()
+{
+	std::vector<VideoScalePath> candidates{{}};
+	if (fs::is_directory("/dev/dri"))
+		for (const auto &entry : fs::directory_iterator{"/dev/dri"})
+			if (entry.path().filename().string().starts_with("renderD"))
+				candidates.push_back({entry.path().string()});
+
+	std::optional<ProbeResult> result;
+	std::vector<std::string> vaapi_devices;
+	double best_time = INFINITY;
+	for (const auto &candidate : candidates)
+	{
+		const auto time = benchmark(candidate);
+		std::cout << "scale path '" << (candidate.vaapi_device.empty() ? "swscale" : candidate.vaapi_device)
+				  << "': " << (time ? std::to_string(*time) + "s" : "unavailable") << '\n';
+		if (time && !candidate.vaapi_device.empty())
+			vaapi_devices.push_back(candidate.vaapi_device);
+		if (time && *time < best_time)
+			result = {candidate}, best_time = *time;
+	}
+	if (result)
+		result->vaapi_devices = std::move(vaapi_devices);
+	return result;
+}
+
+static fs::path cache_file()
+{
+	fs::path dir;
+	if (const auto xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg)
+		dir = xdg;
+	else if (const auto home = getenv("HOME"))
+		dir = fs::path{home} / ".cache";
+	else
+		return {};
+
+	// the cache directory may be shared between hosts (e.g. network homes)
+	char hostname[256]{};
+	gethostname(hostname, sizeof(hostname) - 1);
+	return dir / "audioviz" / (std::string{"scale-path-"} + hostname);
+}
+
+// cached as e.g. "vaapi /dev/dri/renderD128" or "swscale", then "devices" followed by the working render nodes
+static const ProbeResult &probe_result()
+{
+	static const ProbeResult result = []
+	{
+		const auto file = cache_file();
+
+		if (std::ifstream in{file}; in)
+		{
+			ProbeResult cached;
+			std::string kind, devices;
+			in >> kind;
+			if (kind == "vaapi")
+				in >> cached.best.vaapi_device;
+			// caches from before the device list was kept have no "devices" line, so they are probed again
+			if ((kind == "swscale" || kind == "vaapi") && in >> devices && devices == "devices")
+			{
+				// devices can come and go
+				for (std::string device; in >> device;)
+					if (fs::exists(device))
+						cached.vaapi_devices.push_back(device);
+				if (cached.best.vaapi_device.empty() || fs::exists(cached.best.vaapi_device))
+					return cached;
+			}
+		}
+
+		// don't cache a failed probe; ffmpeg itself will report what's wrong
+		const auto result = probe();
+		if (!result)
+			return ProbeResult{};
+
+		if (!file.empty())
+		{
+			std::error_code ec;
+			fs::create_directories(file.parent_path(), ec);
+			std::ofstream out{file};
+			out << (result->best.vaapi_device.empty() ? "swscale" : "vaapi " + result->best.vaapi_device) << "\ndevices";
+			for (const auto &device : result->vaapi_devices)
+				out << ' ' << device;
+			out << '\n';
+		}
+		return *result;
+	}();
+	return result;
+}
+
+const VideoScalePath &VideoScalePath::best()
+{
+	return probe_result().best;
+}
+
+const std::vector<std::string> &VideoScalePath::working_vaapi_devices()
+{
+	return probe_result().vaapi_devices;
+}
+
+#else
+
+const VideoScalePath &VideoScalePath::best()
+{
+	static const VideoScalePath path;
+	return path;
+}
+
+const std::vector<std::string> &VideoScalePath::working_vaapi_devices()
+{
+	static const std::vector<std::string> devices;
+	return devices;
+}
+
+#endif
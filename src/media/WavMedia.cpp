@@ -0,0 +1,355 @@
+#include "media/WavMedia.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+WavMedia::MappedFile::MappedFile(const std::string &path)
+{
+#ifdef _WIN32
+	const auto file = CreateFileA(
+		path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error{"WavMedia: can't open " + path};
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw std::runtime_error{"WavMedia: can't get the size of " + path};
+	}
+	_size = size.QuadPart;
+
+	// empty files can't be mapped, and have nothing to read anyway
+	if (_size)
+	{
+		_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (_mapping)
+			_data = static_cast<const std::byte *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	CloseHandle(file); // the mapping keeps the file open
+
+	if (_size && !_data)
+	{
+		if (_mapping)
+			CloseHandle(_mapping);
+		throw std::runtime_error{"WavMedia: can't map " + path};
+	}
+#else
+	const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error{"WavMedia: can't open " + path + ": " + strerror(errno)};
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		throw std::runtime_error{"WavMedia: can't stat " + path + ": " + strerror(errno)};
+	}
+	_size = st.st_size;
+
+	// empty files can't be mapped, and have nothing to read anyway
+	if (_size)
+	{
+		const auto addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			close(fd);
+			throw std::runtime_error{"WavMedia: can't map " + path + ": " + strerror(errno)};
+		}
+		_data = static_cast<const std::byte *>(addr);
+
+		// we read front to back: let the kernel read ahead aggressively and drop pages behind us
+		madvise(addr, _size, MADV_SEQUENTIAL);
+	}
+	close(fd); // the mapping keeps the file open
+#endif
+}
+
+WavMedia::MappedFile::MappedFile(MappedFile &&other) noexcept
+	: _data{std::exchange(other._data, nullptr)},
+	  _size{std::exchange(other._size, 0)}
+#ifdef _WIN32
+	  ,
+	  _mapping{std::exchange(other._mapping, nullptr)}
+#endif
+{
+}
+
+WavMedia::MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+#else
+	if (_data)
+		munmap(const_cast<std::byte *>(_data), _size);
+#endif
+}
+
+// wav is little-endian, and so is every platform we build for; memcpy because chunks needn't be aligned
+template <typename T>
+static T read_le(const std::span<const std::byte> bytes, const size_t offset)
+{
+	if (offset + sizeof(T) > bytes.size())
+		throw std::runtime_error{"WavMedia: truncated header"};
+	T value;
+	std::memcpy(&value, bytes.data() + offset, sizeof(T));
+	return value;
+}
+
+static bool has_id(const std::span<const std::byte> bytes, const size_t offset, const char *const id)
+{
+	return offset + 4 <= bytes.size() && !std::memcmp(bytes.data() + offset, id, 4);
+}
+
+// a LIST/INFO text value: nul-terminated, possibly padded with more nuls
+static std::string info_string(const std::span<const std::byte> value)
+{
+	const auto chars = reinterpret_cast<const char *>(value.data());
+	return {chars, strnlen(chars, value.size())};
+}
+
+static size_t sample_bytes(const WavMedia::SampleFormat format)
+{
+	switch (format)
+	{
+	case WavMedia::SampleFormat::S16:
+		return 2;
+	case WavMedia::SampleFormat::S24:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+WavMedia::Layout WavMedia::parse(const std::span<const std::byte> file)
+{
+	const bool rf64 = has_id(file, 0, "RF64");
+	if (!(has_id(file, 0, "RIFF") || rf64) || !has_id(file, 8, "WAVE"))
+		throw std::runtime_error{"WavMedia: not a RIFF/RF64 WAVE file"};
+
+	Layout layout{};
+	bool have_fmt{}, have_data{};
+	uint64_t ds64_data_size{}, data_size{};
+
+	for (size_t pos = 12; pos + 8 <= file.size();)
+	{
+		const auto body = pos + 8;
+		uint64_t size = read_le<uint32_t>(file, pos + 4);
+
+		if (has_id(file, pos, "ds64"))
+			// riff size, then data size
+			ds64_data_size = read_le<uint64_t>(file, body + 8);
+		else if (has_id(file, pos, "fmt "))
+		{
+			auto tag = read_le<uint16_t>(file, body);
+			layout.nb_channels = read_le<uint16_t>(file, body + 2);
+			layout.sample_rate = read_le<uint32_t>(file, body + 4);
+			const auto bits = read_le<uint16_t>(file, body + 14);
+
+			// WAVE_FORMAT_EXTENSIBLE: the real format tag starts the subformat guid
+			if (tag == 0xFFFE && size >= 40)
+				tag = read_le<uint16_t>(file, body + 24);
+
+			if (tag == 1 && bits == 16)
+				layout.format = SampleFormat::S16;
+			else if (tag == 1 && bits == 24)
+				layout.format = SampleFormat::S24;
+			else if (tag == 1 && bits == 32)
+				layout.format = SampleFormat::S32;
+			else if (tag == 3 && bits == 32)
+				layout.format = SampleFormat::F32;
+			else
+				throw std::runtime_error{
+					"WavMedia: unsupported sample format (tag " + std::to_string(tag) + ", " + std::to_string(bits) +
+					" bits)"};
+
+			if (!layout.nb_channels || !layout.sample_rate)
+				throw std::runtime_error{"WavMedia: no channels or no sample rate"};
+			have_fmt = true;
+		}
+		else if (has_id(file, pos, "LIST") && has_id(file, body, "INFO"))
+		{
+			const auto end = std::min<uint64_t>(body + size, file.size());
+			for (auto sub = body + 4; sub + 8 <= end;)
+			{
+				const uint64_t sub_size = read_le<uint32_t>(file, sub + 4);
+				const auto value = file.subspan(sub + 8, std::min(sub_size, end - sub - 8));
+				if (has_id(file, sub, "INAM"))
+					layout.title = info_string(value);
+				else if (has_id(file, sub, "IART"))
+					layout.artist = info_string(value);
+				sub += 8 + sub_size + (sub_size & 1);
+			}
+		}
+		else if (has_id(file, pos, "data"))
+		{
+			if (rf64 && size == 0xFFFFFFFF)
+				size = ds64_data_size;
+			layout.data_offset = body;
+			data_size = std::min<uint64_t>(size, file.size() - body);
+			have_data = true;
+		}
+
+		pos = body + size + (size & 1); // chunks are padded to even sizes
+	}
+
+	if (!have_fmt || !have_data)
+		throw std::runtime_error{"WavMedia: missing fmt or data chunk"};
+
+	layout.total_frames = data_size / (sample_bytes(layout.format) * layout.nb_channels);
+	return layout;
+}
+
+WavMedia::WavMedia(const std::string &path)
+	: WavMedia{path, MappedFile{path}}
+{
+}
+
+WavMedia::WavMedia(const std::string &path, MappedFile &&file)
+	: WavMedia{path, std::move(file), parse(file.bytes())}
+{
+}
+
+WavMedia::WavMedia(const std::string &path, const int sample_rate, const int nb_channels)
+	: WavMedia{path, MappedFile{path}, {SampleFormat::F32, sample_rate, nb_channels, 0, SIZE_MAX}}
+{
+}
+
+WavMedia::WavMedia(const std::string &path, MappedFile &&file, const Layout &layout)
+	: Media{path, {}, layout.sample_rate, layout.nb_channels},
+	  _file{std::move(file)},
+	  _layout{layout},
+	  _frame_bytes{sample_bytes(layout.format) * layout.nb_channels}
+{
+	_layout.total_frames = std::min(_layout.total_frames, (_file.bytes().size() - _layout.data_offset) / _frame_bytes);
+}
+
+WavMedia::WavMedia(const std::string &path, const Source &source)
+	: Media{source, {}},
+	  _file{path},
+	  _layout{parse(_file.bytes())},
+	  _frame_bytes{sample_bytes(_layout.format) * _layout.nb_channels}
+{
+	if (_layout.sample_rate != _sample_rate || _layout.nb_channels != _nb_channels)
+		throw std::runtime_error{"WavMedia: " + path + " doesn't match the audio of " + url};
+
+	if (const auto itr = std::ranges::find_if(
+			_reader->streams(), [](const auto &s) { return s->disposition & AV_DISPOSITION_ATTACHED_PIC; });
+		itr != _reader->streams().cend())
+	{
+		const auto &stream = *itr;
+		_attached_pic_data = {stream->attached_pic.data, (size_t)stream->attached_pic.size};
+	}
+}
+
+bool WavMedia::is_supported(const std::string &path)
+{
+	try
+	{
+		parse(MappedFile{path}.bytes());
+		return true;
+	}
+	catch (const std::runtime_error &)
+	{
+		return false;
+	}
+}
+
+const float *WavMedia::next_frames(const size_t frames)
+{
+	const auto src = _file.bytes().data() + _layout.data_offset + _position * _frame_bytes;
+	const auto samples = frames * _layout.nb_channels;
+	_position += frames;
+
+	// float samples are used in place; the data chunk is 4-byte aligned in practically every file
+	if (_layout.format == SampleFormat::F32 && reinterpret_cast<uintptr_t>(src) % alignof(float) == 0)
+		return reinterpret_cast<const float *>(src);
+
+	if (_converted.size() < samples)
+		_converted.resize(samples);
+
+	// plain loops over restrict pointers, so that they vectorize; see CMakeLists.txt.
+	// memcpy reads are alignment-safe and compile to plain loads
+	const auto *const __restrict in = reinterpret_cast<const uint8_t *>(src);
+	float *const __restrict out = _converted.data();
+	switch (_layout.format)
+	{
+	case SampleFormat::S16:
+		for (size_t i = 0; i < samples; ++i)
+		{
+			int16_t s;
+			std::memcpy(&s, in + 2 * i, 2);
+			out[i] = s * (1.f / 32768);
+		}
+		break;
+	case SampleFormat::S24:
+		// into the top 24 bits of an int32, so the sign comes for free
+		for (size_t i = 0; i < samples; ++i)
+		{
+			const auto s = (int32_t)((uint32_t)in[3 * i] << 8 | (uint32_t)in[3 * i + 1] << 16 | (uint32_t)in[3 * i + 2] << 24);
+			out[i] = s * (1.f / 2147483648);
+		}
+		break;
+	case SampleFormat::S32:
+		for (size_t i = 0; i < samples; ++i)
+		{
+			int32_t s;
+			std::memcpy(&s, in + 4 * i, 4);
+			out[i] = s * (1.f / 2147483648);
+		}
+		break;
+	case SampleFormat::F32:
+		std::memcpy(out, in, samples * sizeof(float));
+		break;
+	}
+	return out;
+}
+
+void WavMedia::decode_audio(const int frames)
+{
+	if (_audio_buffer.frames() >= frames)
+		return;
+	const auto count = std::min<size_t>(frames - _audio_buffer.frames(), _layout.total_frames - _position);
+	if (count)
+		write_audio(next_frames(count), count);
+}
+
+void WavMedia::seek(const double seconds)
+{
+	_position = std::clamp<double>(std::round(seconds * _layout.sample_rate), 0, _layout.total_frames);
+	_audio_buffer.clear();
+}
+
+size_t WavMedia::read_audio_samples(float *const buf, const int samples)
+{
+	const auto count = std::min<size_t>(samples / _layout.nb_channels, _layout.total_frames - _position);
+	std::ranges::copy_n(next_frames(count), count * _layout.nb_channels, buf);
+	return count * _layout.nb_channels;
+}
+
+std::optional<std::string> WavMedia::metadata(const std::string &key) const
+{
+	if (probed())
+		return Media::metadata(key);
+	const auto &value = (key == "title") ? _layout.title : (key == "artist") ? _layout.artist : std::string{};
+	if (value.empty())
+		return {};
+	return value;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "tt/AnalysisGraph.hpp"
+#include "tt/ThreadPool.hpp"
+
+namespace tt
+{
+
+AnalysisGraph::Transform::Transform(const int fft_size, const FA::WindowFunction wf)
+	: fft_size{fft_size},
+	  wf{wf},
+	  window(fft_size)
+{
+	// the window only depends on the fft size, so compute it once instead of every frame
+	for (int i = 0; i < fft_size; ++i)
+		window[i] = FA::window(wf, i, fft_size);
+}
+
+void AnalysisGraph::Transform::reserve_channels(const int num_channels)
+{
+	while ((int)ffts.size() < num_channels)
+		ffts.emplace_back(new fftw::dft_r2c_1d<float>{fft_size});
+	if ((int)amplitudes.size() < num_channels)
+		amplitudes.resize(num_channels);
+}
+
+void AnalysisGraph::Transform::execute(const float *const audio, const int channel)
+{
+	auto &fftw = *ffts[channel];
+	const auto input = fftw.input();
+	for (int i = 0; i < fft_size; ++i)
+		input[i] = audio[i] * window[i];
+
+	fftw.execute();
+	const auto output = fftw.output();
+
+	auto &amps = amplitudes[channel];
+	amps.resize(fftw.output_size());
+	for (int i = 0; i < fftw.output_size(); ++i)
+	{
+		const auto [re, im] = output[i];
+		amps[i] = sqrt((re * re) + (im * im)) / fft_size;
+	}
+}
+
+void AnalysisGraph::add(FA &fa, AudioAnalyzer &aa)
+{
+	nodes.emplace_back(fa, aa);
+}
+
+int AnalysisGraph::required_frames() const
+{
+	int frames{};
+	for (const auto &node : nodes)
+		frames = std::max(frames, node.fa.get_fft_size());
+	return frames;
+}
+
+AnalysisGraph::Transform &AnalysisGraph::get_transform(const int fft_size, const FA::WindowFunction wf)
+{
+	const auto itr =
+		std::ranges::find_if(transforms, [&](const auto &t) { return t.fft_size == fft_size && t.wf == wf; });
+	return (itr != transforms.end()) ? *itr : transforms.emplace_back(fft_size, wf);
+}
+
+int AnalysisGraph::prepare(const int num_channels)
+{
+	if (num_channels <= 0)
+		throw std::invalid_argument("num_channels <= 0");
+
+	// only analyze as many channels as the widest analyzer needs
+	int channels_used{};
+	for (const auto &node : nodes)
+		channels_used = std::max(channels_used, node.aa.get_num_channels());
+	if (channels_used > num_channels)
+		throw std::invalid_argument("AnalysisGraph::analyze: an analyzer has more channels than the audio");
+
+	// everything that allocates or plans happens here, before channels fan out
+	for (auto &t : transforms)
+		t.num_channels = 0;
+
+	node_transforms.clear();
+	for (const auto &node : nodes)
+	{
+		auto &t = get_transform(node.fa.get_fft_size(), node.fa.get_window_func());
+		t.num_channels = std::max(t.num_channels, node.aa.get_num_channels());
+		node_transforms.push_back(&t);
+	}
+
+	// drop transforms nobody uses anymore, e.g. after `set_fft_size`
+	transforms.remove_if([](const auto &t) { return !t.num_channels; });
+
+	for (auto &t : transforms)
+		t.reserve_channels(t.num_channels);
+
+	return channels_used;
+}
+
+void AnalysisGraph::for_each_channel(const int channels_used, const std::function<void(int)> &f)
+{
+	// channels are independent from here on
+	if (channels_used > 1 && channels_used * required_frames() >= AudioAnalyzer::PARALLEL_THRESHOLD)
+		ThreadPool::shared().parallel_for(channels_used, f);
+	else
+		for (int ch = 0; ch < channels_used; ++ch)
+			f(ch);
+}
+
+void AnalysisGraph::analyze(const float *const audio, const int num_channels, const bool interleaved)
+{
+	const auto channels_used = prepare(num_channels);
+	const auto frames = required_frames();
+
+	if (!interleaved)
+	{
+		// planar audio can be read in place
+		for_each_channel(channels_used, [&](const int ch) { analyze_channel(audio + ch * frames, ch); });
+		return;
+	}
+
+	channels.resize(channels_used);
+	for (auto &channel : channels)
+		channel.resize(frames);
+
+	for_each_channel(
+		channels_used,
+		[&](const int ch)
+		{
+			auto &channel = channels[ch];
+			for (int i = 0; i < frames; ++i)
+				channel[i] = audio[i * num_channels + ch];
+			analyze_channel(channel.data(), ch);
+		});
+}
+
+void AnalysisGraph::analyze(const float *const *const channels, const int num_channels)
+{
+	const auto channels_used = prepare(num_channels);
+	for_each_channel(channels_used, [&](const int ch) { analyze_channel(channels[ch], ch); });
+}
+
+void AnalysisGraph::analyze_channel(const float *const audio, const int ch)
+{
+	// run each transform once; every node with the same settings reuses its amplitudes
+	for (auto &t : transforms)
+		if (ch < t.num_channels)
+			t.execute(audio, ch);
+
+	for (int i = 0; i < (int)nodes.size(); ++i)
+	{
+		auto &[fa, aa] = nodes[i];
+		if (ch >= aa.get_num_channels())
+			continue;
+		auto &scratch = FA::thread_scratch(fa.get_fft_size());
+		fa.render_amplitudes(scratch, node_transforms[i]->amplitudes[ch].data(), aa._spectrum_data_per_channel[ch]);
+		aa.smooth(ch);
+	}
+}
+
+const std::vector<float> &AnalysisGraph::get_amplitudes(const FA &fa, const int channel) const
+{
+	const auto itr = std::ranges::find_if(
+		transforms,
+		[&](const auto &t) { return t.fft_size == fa.get_fft_size() && t.wf == fa.get_window_func(); });
+	if (itr == transforms.end() || channel < 0 || channel >= (int)itr->amplitudes.size())
+		throw std::invalid_argument("AnalysisGraph::get_amplitudes: no amplitudes for this analyzer/channel");
+	return itr->amplitudes[channel];
+}
+
+} // namespace tt
@@ -1,4 +1,7 @@
 #include "tt/AudioAnalyzer.hpp"
+#include "tt/ThreadPool.hpp"
+
+#include <algorithm>
 
 namespace tt
 {
@@ -15,15 +18,59 @@ void AudioAnalyzer::resize(const int size)
 		_spectrum_data_per_channel[i].resize(size);
 }
 
+void AudioAnalyzer::clear()
+{
+	for (auto &spectrum : _spectrum_data_per_channel)
+		std::ranges::fill(spectrum, 0);
+}
+
 void AudioAnalyzer::analyze(tt::FrequencyAnalyzer &fa, const float *const audio, const bool interleaved)
 {
+	if (_num_channels > 1 && _num_channels * fa.get_fft_size() >= PARALLEL_THRESHOLD)
+	{
+		// every thread works with its own scratch, `fa` is only read
+		ThreadPool::shared().parallel_for(
+			_num_channels,
+			[&](const int i)
+			{
+				auto &scratch = FrequencyAnalyzer::thread_scratch(fa.get_fft_size());
+				fa.copy_channel_to_input(scratch, audio, _num_channels, i, interleaved);
+				fa.render(scratch, _spectrum_data_per_channel[i]);
+				smooth(i);
+			});
+		return;
+	}
+
 	for (int i = 0; i < _num_channels; ++i)
 	{
 		fa.copy_channel_to_input(audio, _num_channels, i, interleaved);
 		fa.render(_spectrum_data_per_channel[i]);
+		smooth(i);
 	}
 }
 
+void AudioAnalyzer::set_smoother(const SpectrumSmoother &smoother)
+{
+	_smoothers.assign(_num_channels, smoother);
+}
+
+void AudioAnalyzer::disable_smoother()
+{
+	_smoothers.clear();
+}
+
+void AudioAnalyzer::reset_smoother()
+{
+	for (auto &smoother : _smoothers)
+		smoother.reset();
+}
+
+void AudioAnalyzer::smooth(const int channel)
+{
+	if (!_smoothers.empty())
+		_smoothers[channel].process(_spectrum_data_per_channel[channel]);
+}
+
 int AudioAnalyzer::get_num_channels() const
 {
 	return _num_channels;
@@ -1,4 +1,5 @@
 #include <cstring>
+#include <list>
 #include <stdexcept>
 
 #include "tt/FrequencyAnalyzer.hpp"
@@ -16,7 +17,7 @@ FrequencyAnalyzer::FrequencyAnalyzer(const int fft_size)
 void FrequencyAnalyzer::set_fft_size(const int fft_size)
 {
 	this->fft_size = fft_size;
-	fftw.set_n(fft_size);
+	scratch.fftw.set_n(fft_size);
 	scale_max.set(*this);
 }
 
@@ -50,11 +51,23 @@ void FrequencyAnalyzer::set_nth_root(const int nth_root)
 
 void FrequencyAnalyzer::copy_to_input(const float *const wavedata)
 {
-	memcpy(fftw.input(), wavedata, fft_size * sizeof(float));
+	copy_to_input(scratch, wavedata);
+}
+
+void FrequencyAnalyzer::copy_to_input(Scratch &scratch, const float *const wavedata) const
+{
+	scratch.fftw.set_n(fft_size);
+	memcpy(scratch.fftw.input(), wavedata, fft_size * sizeof(float));
 }
 
 void FrequencyAnalyzer::copy_channel_to_input(
 	const float *const audio, const int num_channels, const int channel, const bool interleaved)
+{
+	copy_channel_to_input(scratch, audio, num_channels, channel, interleaved);
+}
+
+void FrequencyAnalyzer::copy_channel_to_input(
+	Scratch &scratch, const float *const audio, const int num_channels, const int channel, const bool interleaved) const
 {
 	if (num_channels <= 0)
 		throw std::invalid_argument("num_channels <= 0");
@@ -65,18 +78,26 @@ void FrequencyAnalyzer::copy_channel_to_input(
 
 	if (!interleaved)
 	{
-		copy_to_input(audio + (channel * fft_size));
+		copy_to_input(scratch, audio + (channel * fft_size));
 		return;
 	}
 
-	const auto input = fftw.input();
+	scratch.fftw.set_n(fft_size);
+	const auto input = scratch.fftw.input();
 	for (int i = 0; i < fft_size; ++i)
 		input[i] = audio[i * num_channels + channel];
 }
 
 void FrequencyAnalyzer::render(std::vector<float> &spectrum)
 {
-	assert(spectrum.size());
+	render(scratch, spectrum);
+}
+
+void FrequencyAnalyzer::render(Scratch &scratch, std::vector<float> &spectrum) const
+{
+	auto &fftw = scratch.fftw;
+	if (fftw.input_size() != fft_size)
+		throw std::logic_error("FrequencyAnalyzer::render: scratch was not filled with copy_to_input");
 
 	// apply window function on input
 	const auto input = fftw.input();
@@ -87,16 +108,37 @@ void FrequencyAnalyzer::render(std::vector<float> &spectrum)
 	fftw.execute();
 	const auto output = fftw.output();
 
-	// zero out array since we are accumulating
-	std::ranges::fill(spectrum, 0);
-
-	// map frequency bins of freqdata to spectrum
+	auto &amplitudes = scratch.amplitudes;
+	amplitudes.resize(fftw.output_size());
 	for (int i = 0; i < fftw.output_size(); ++i)
 	{
 		const auto [re, im] = output[i];
 		// must divide by fft_size here to counteract the correlation
 		// between fft_size and the average amplitude across the spectrum vector.
-		const float amplitude = sqrt((re * re) + (im * im)) / fft_size;
+		amplitudes[i] = sqrt((re * re) + (im * im)) / fft_size;
+	}
+
+	render_amplitudes(scratch, amplitudes.data(), spectrum);
+}
+
+void FrequencyAnalyzer::render_amplitudes(const float *const amplitudes, std::vector<float> &spectrum)
+{
+	render_amplitudes(scratch, amplitudes, spectrum);
+}
+
+void FrequencyAnalyzer::render_amplitudes(
+	Scratch &scratch, const float *const amplitudes, std::vector<float> &spectrum) const
+{
+	assert(spectrum.size());
+
+	// zero out array since we are accumulating
+	std::ranges::fill(spectrum, 0);
+
+	// map frequency bins of freqdata to spectrum
+	const auto num_amplitudes = fft_size / 2 + 1;
+	for (int i = 0; i < num_amplitudes; ++i)
+	{
+		const auto amplitude = amplitudes[i];
 		const auto index = calc_index(i, spectrum.size());
 
 		switch (am)
@@ -116,21 +158,46 @@ void FrequencyAnalyzer::render(std::vector<float> &spectrum)
 
 	// apply interpolation if necessary
 	if (interp != InterpolationType::NONE && scale != Scale::LINEAR)
-		interpolate(spectrum);
+		interpolate(scratch, spectrum);
+}
+
+FrequencyAnalyzer::Scratch &FrequencyAnalyzer::thread_scratch(const int fft_size)
+{
+	thread_local std::list<Scratch> scratches;
+
+	if (const auto itr =
+			std::ranges::find_if(scratches, [&](const auto &s) { return s.fftw.input_size() == fft_size; });
+		itr != scratches.end())
+	{
+		// most recently used goes first
+		scratches.splice(scratches.begin(), scratches, itr);
+		return scratches.front();
+	}
+
+	if (scratches.size() >= 4)
+		scratches.pop_back();
+	return scratches.emplace_front(fft_size);
 }
 
 float FrequencyAnalyzer::window_func(const int i) const
+{
+	return window(wf, i, fft_size);
+}
+
+float FrequencyAnalyzer::window(const WindowFunction wf, const int i, const int size)
 {
 	switch (wf)
 	{
+	case WindowFunction::NONE:
+		return 1;
 	case WindowFunction::HANNING:
-		return 0.5f * (1 - cos(2 * M_PI * i / (fft_size - 1)));
+		return 0.5f * (1 - cos(2 * M_PI * i / (size - 1)));
 	case WindowFunction::HAMMING:
-		return 0.54f - 0.46f * cos(2 * M_PI * i / (fft_size - 1));
+		return 0.54f - 0.46f * cos(2 * M_PI * i / (size - 1));
 	case WindowFunction::BLACKMAN:
-		return 0.42f - 0.5f * cos(2 * M_PI * i / (fft_size - 1)) + 0.08f * cos(4 * M_PI * i / (fft_size - 1));
+		return 0.42f - 0.5f * cos(2 * M_PI * i / (size - 1)) + 0.08f * cos(4 * M_PI * i / (size - 1));
 	default:
-		throw std::logic_error("FrequencySpectrum::window_func: default case hit");
+		throw std::logic_error("FrequencySpectrum::window: default case hit");
 	}
 }
 
@@ -164,10 +231,12 @@ float FrequencyAnalyzer::calc_index_ratio(const float i) const
 	}
 }
 
-void FrequencyAnalyzer::interpolate(std::vector<float> &spectrum)
+void FrequencyAnalyzer::interpolate(Scratch &scratch, std::vector<float> &spectrum) const
 {
 	// separate the nonzero values (y's) and their indices (x's)
-	std::vector<double> nonzero_values, indices;
+	auto &nonzero_values = scratch.nonzero_values, &indices = scratch.indices;
+	nonzero_values.clear();
+	indices.clear();
 	for (int i = 0; i < (int)spectrum.size(); ++i)
 	{
 		if (!spectrum[i])
@@ -180,6 +249,7 @@ void FrequencyAnalyzer::interpolate(std::vector<float> &spectrum)
 	if (indices.size() < 3)
 		return;
 
+	auto &spline = scratch.spline;
 	spline.set_points(indices, nonzero_values, (tk::spline::spline_type)interp);
 
 	// only copy spline values to fill in the gaps
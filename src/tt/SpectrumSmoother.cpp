@@ -0,0 +1,90 @@
+#include <stdexcept>
+
+#include "tt/SpectrumSmoother.hpp"
+
+namespace tt
+{
+
+SpectrumSmoother::SpectrumSmoother(const float attack, const float release)
+{
+	set_attack(attack);
+	set_release(release);
+}
+
+void SpectrumSmoother::set_attack(const float attack)
+{
+	if (attack <= 0 || attack > 1)
+		throw std::invalid_argument("SpectrumSmoother: attack must be in (0, 1]");
+	this->attack = attack;
+}
+
+void SpectrumSmoother::set_release(const float release)
+{
+	if (release <= 0 || release > 1)
+		throw std::invalid_argument("SpectrumSmoother: release must be in (0, 1]");
+	this->release = release;
+}
+
+void SpectrumSmoother::set_peak_hold(const int hold_frames, const float decay)
+{
+	if (decay < 0 || decay > 1)
+		throw std::invalid_argument("SpectrumSmoother: peak decay must be in [0, 1]");
+	this->hold_frames = hold_frames;
+	peak_decay = decay;
+}
+
+void SpectrumSmoother::reset()
+{
+	smoothed.clear();
+	peaks.clear();
+	held_for.clear();
+}
+
+void SpectrumSmoother::process(std::vector<float> &spectrum)
+{
+	const int size = spectrum.size();
+
+	// first frame, or the spectrum was resized: start from the input
+	if ((int)smoothed.size() != size)
+	{
+		smoothed = spectrum;
+		peaks = spectrum;
+		held_for.assign(size, 0);
+		return;
+	}
+
+	// the loops below have no branches, only selects, so that they vectorize.
+	// see CMakeLists.txt for the flags this file needs for that
+
+	float *const __restrict out = spectrum.data();
+	float *const __restrict s = smoothed.data();
+	const auto attack = this->attack, release = this->release;
+
+	for (int i = 0; i < size; ++i)
+	{
+		const auto coef = (out[i] > s[i]) ? attack : release;
+		s[i] += coef * (out[i] - s[i]);
+		out[i] = s[i];
+	}
+
+	if (hold_frames < 0)
+		return;
+
+	float *const __restrict p = peaks.data();
+	float *const __restrict h = held_for.data();
+	const float hold = hold_frames, decay = peak_decay;
+
+	for (int i = 0; i < size; ++i)
+	{
+		const auto held = h[i] + 1;
+		const auto kept = (held > hold) ? p[i] * decay : p[i];
+		// whenever the input becomes the peak, e.g. above a peak that's already decaying, it's held anew
+		const auto taken = out[i] >= kept;
+		const auto peak = taken ? out[i] : kept;
+		h[i] = taken ? 0.f : held;
+		p[i] = peak;
+		out[i] = peak;
+	}
+}
+
+} // namespace tt
@@ -0,0 +1,244 @@
+#include "tt/Telemetry.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace tt
+{
+
+static FILE *open_dest(const std::string &dest)
+{
+	FILE *file{};
+#ifndef _WIN32
+	if (dest.starts_with("fd:"))
+		file = fdopen(std::stoi(dest.substr(3)), "w");
+	else if (dest.starts_with("unix:"))
+	{
+		const auto path = dest.substr(5);
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+			throw std::system_error{ENAMETOOLONG, std::generic_category(), "telemetry: " + path};
+		std::ranges::copy(path, addr.sun_path);
+
+		const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			throw std::system_error{errno, std::generic_category(), "telemetry: socket"};
+		if (connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0)
+		{
+			const auto err = errno;
+			close(fd);
+			throw std::system_error{err, std::generic_category(), "telemetry: connect to " + path};
+		}
+		if (!(file = fdopen(fd, "w")))
+			close(fd);
+	}
+	else
+#endif
+		file = fopen(dest.c_str(), "w");
+
+	if (!file)
+		throw std::system_error{errno, std::generic_category(), "telemetry: can't open " + dest};
+	return file;
+}
+
+static std::string json_number(const double value)
+{
+	if (!std::isfinite(value))
+		return "null";
+	std::ostringstream ss;
+	ss << value;
+	return ss.str();
+}
+
+static std::string json_string(const std::string_view value)
+{
+	std::string out{'"'};
+	for (const auto c : value)
+		switch (c)
+		{
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			}
+			else
+				out += c;
+		}
+	return out += '"';
+}
+
+std::string Telemetry::field(const std::string_view key, const std::string_view value)
+{
+	return json_string(key) + ':' + json_string(value);
+}
+
+std::string Telemetry::field(const std::string_view key, const double value)
+{
+	return json_string(key) + ':' + json_number(value);
+}
+
+Telemetry::Telemetry(const std::string &dest, const double interval)
+	: file{open_dest(dest)},
+	  interval{std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval))}
+{
+	reporter = std::jthread{[this](const std::stop_token st) { report(st); }};
+}
+
+Telemetry::~Telemetry()
+{
+	{
+		const std::lock_guard lock{mutex};
+		ok = !std::uncaught_exceptions();
+	}
+	reporter.request_stop();
+	reporter.join();
+	fclose(file);
+}
+
+void Telemetry::frame(const double position, const std::optional<double> duration, const std::span<const Stage> stages)
+{
+	const std::lock_guard lock{mutex};
+	++frames;
+	this->position = position;
+	this->duration = duration;
+	for (const auto &[label, ms] : stages)
+	{
+		auto itr = std::ranges::find(stage_totals, label, &StageTotal::label);
+		if (itr == stage_totals.end())
+			itr = stage_totals.insert(itr, {std::string{label}, 0, 0});
+		itr->ms += ms;
+		++itr->count;
+	}
+}
+
+void Telemetry::event(const std::string_view name, const std::initializer_list<std::string> fields)
+{
+	std::string line = '{' + field("event", name) + ',' +
+					   field("elapsed", std::chrono::duration<double>(Clock::now() - start).count());
+	for (const auto &f : fields)
+		line += ',' + f;
+	line += "}\n";
+
+	{
+		const std::lock_guard lock{mutex};
+		events.push_back(std::move(line));
+	}
+	cv.notify_one();
+}
+
+std::string Telemetry::progress(
+	const Clock::time_point now, Clock::time_point &last, int64_t &last_frames, double &last_position)
+{
+	const auto seconds = std::chrono::duration<double>(now - last).count();
+	const auto fps = (frames - last_frames) / seconds;
+	const auto realtime = (position - last_position) / seconds;
+
+	std::string line = '{' + field("event", "progress") + ',' +
+					   field("elapsed", std::chrono::duration<double>(now - start).count()) + ',' +
+					   field("frames", frames) + ',' + field("position", position) + ',';
+	if (duration && *duration > 0)
+		line += field("duration", *duration) + ',' + field("progress", std::min(position / *duration, 1.)) + ',' +
+				field("eta", (realtime > 0) ? std::max(*duration - position, 0.) / realtime : NAN) + ',';
+	else
+		line += R"("duration":null,"progress":null,"eta":null,)";
+	line += field("fps", fps) + ',' + field("realtime", realtime) + R"(,"stages":{)";
+	for (auto &stage : stage_totals)
+	{
+		if (stage.count)
+			line += field(stage.label, stage.ms / stage.count) + ',';
+		stage.ms = stage.count = 0;
+	}
+	if (line.back() == ',')
+		line.pop_back();
+	line += "}}\n";
+
+	last = now;
+	last_frames = frames;
+	last_position = position;
+	return line;
+}
+
+void Telemetry::report(const std::stop_token st)
+{
+#ifndef _WIN32
+	// a reader that went away makes writes fail with EPIPE, instead of killing the process.
+	// SIGPIPE goes to the writing thread, so blocking it here doesn't affect anything else
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, nullptr);
+#endif
+
+	bool failed{};
+	const auto write = [&](const std::string &line)
+	{
+		if (failed)
+			return;
+		if (fputs(line.c_str(), file) < 0 || fflush(file))
+		{
+			std::cerr << "telemetry: " << std::generic_category().message(errno) << ", stopping\n";
+			failed = true;
+		}
+	};
+
+	auto last = start;
+	int64_t last_frames{};
+	double last_position{};
+
+	std::unique_lock lock{mutex};
+	while (true)
+	{
+		const auto stopping = st.stop_requested();
+		if (!stopping)
+			cv.wait_until(lock, st, last + interval, [&] { return !events.empty(); });
+
+		const auto pending = std::exchange(events, {});
+		const auto now = Clock::now();
+		std::string line;
+		if (stopping || now >= last + interval)
+			line = progress(now, last, last_frames, last_position);
+		if (stopping)
+			line += '{' + field("event", "end") + ',' +
+					field("elapsed", std::chrono::duration<double>(now - start).count()) + ",\"ok\":" +
+					(ok ? "true" : "false") + "}\n";
+
+		// nothing blocks `frame` while writing
+		lock.unlock();
+		for (const auto &event : pending)
+			write(event);
+		if (!line.empty())
+			write(line);
+		lock.lock();
+
+		if (stopping)
+			return;
+	}
+}
+
+} // namespace tt
@@ -0,0 +1,118 @@
+#include "tt/ThreadPool.hpp"
+
+namespace tt
+{
+
+ThreadPool::ThreadPool(const int num_threads)
+{
+	for (int i = 0; i < num_threads; ++i)
+		workers.emplace_back(
+			[this]
+			{
+				while (true)
+				{
+					std::move_only_function<void()> task;
+					{
+						std::unique_lock lock{mutex};
+						cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+						if (tasks.empty())
+							return; // stopping and nothing left to do
+						task = std::move(tasks.front());
+						tasks.pop();
+					}
+					task();
+				}
+			});
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		const std::lock_guard lock{mutex};
+		stopping = true;
+	}
+	cv.notify_all();
+	// join here, before the mutex and condition variable are destroyed
+	workers.clear();
+}
+
+ThreadPool &ThreadPool::shared()
+{
+	static ThreadPool pool{std::max(1, (int)std::thread::hardware_concurrency() - 1)};
+	return pool;
+}
+
+std::future<void> ThreadPool::submit(std::move_only_function<void()> task)
+{
+	std::packaged_task<void()> pt{std::move(task)};
+	auto future = pt.get_future();
+	{
+		const std::lock_guard lock{mutex};
+		tasks.emplace(std::move(pt));
+	}
+	cv.notify_one();
+	return future;
+}
+
+bool ThreadPool::run_pending_task()
+{
+	std::move_only_function<void()> task;
+	{
+		const std::lock_guard lock{mutex};
+		if (tasks.empty())
+			return false;
+		task = std::move(tasks.front());
+		tasks.pop();
+	}
+	task();
+	return true;
+}
+
+void ThreadPool::wait(std::future<void> &future)
+{
+	while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		if (!run_pending_task())
+			future.wait_for(std::chrono::microseconds(50));
+	future.get();
+}
+
+void ThreadPool::parallel_for(const int n, const std::function<void(int)> &f)
+{
+	if (n <= 0)
+		return;
+
+	std::vector<std::future<void>> futures;
+	futures.reserve(n - 1);
+	for (int i = 1; i < n; ++i)
+		futures.emplace_back(submit([&f, i] { f(i); }));
+
+	// do one share of the work on this thread instead of just waiting
+	std::exception_ptr error;
+	try
+	{
+		f(0);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	// every future must be waited on before returning, since the tasks reference `f`
+	for (auto &future : futures)
+	{
+		try
+		{
+			wait(future);
+		}
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+} // namespace tt
@@ -0,0 +1,196 @@
+#include "tt/VideoFramePool.hpp"
+
+#include <SFML/OpenGL.hpp>
+#include <SFML/Window/Context.hpp>
+#include <optional>
+#include <stdexcept>
+
+#ifndef GLAPIENTRY
+#ifdef _WIN32
+#define GLAPIENTRY __stdcall
+#else
+#define GLAPIENTRY
+#endif
+#endif
+
+// not in every platform's gl.h
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#define GL_PIXEL_UNPACK_BUFFER_BINDING 0x88EF
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+
+namespace
+{
+
+// buffer object functions aren't part of opengl 1.1, so they have to be loaded at runtime
+struct GlBufferFunctions
+{
+	using ptrdiff = std::ptrdiff_t;
+	void(GLAPIENTRY *GenBuffers)(GLsizei, GLuint *);
+	void(GLAPIENTRY *DeleteBuffers)(GLsizei, const GLuint *);
+	void(GLAPIENTRY *BindBuffer)(GLenum, GLuint);
+	void(GLAPIENTRY *BufferData)(GLenum, ptrdiff, const void *, GLenum);
+	void *(GLAPIENTRY *MapBufferRange)(GLenum, ptrdiff, ptrdiff, GLbitfield);
+	GLboolean(GLAPIENTRY *UnmapBuffer)(GLenum);
+
+	bool loaded() const { return GenBuffers && DeleteBuffers && BindBuffer && BufferData && MapBufferRange && UnmapBuffer; }
+
+	static const GlBufferFunctions &get()
+	{
+		static const GlBufferFunctions gl{
+			reinterpret_cast<decltype(GenBuffers)>(sf::Context::getFunction("glGenBuffers")),
+			reinterpret_cast<decltype(DeleteBuffers)>(sf::Context::getFunction("glDeleteBuffers")),
+			reinterpret_cast<decltype(BindBuffer)>(sf::Context::getFunction("glBindBuffer")),
+			reinterpret_cast<decltype(BufferData)>(sf::Context::getFunction("glBufferData")),
+			reinterpret_cast<decltype(MapBufferRange)>(sf::Context::getFunction("glMapBufferRange")),
+			reinterpret_cast<decltype(UnmapBuffer)>(sf::Context::getFunction("glUnmapBuffer")),
+		};
+		return gl;
+	}
+};
+
+// sfml only makes sure a context is active inside its own calls; we need one for ours.
+// buffers and textures are shared between sfml's contexts, so whichever is active will do
+struct ContextGuard
+{
+	std::optional<sf::Context> context;
+
+	ContextGuard()
+	{
+		if (!sf::Context::getActiveContext())
+			context.emplace();
+	}
+};
+
+// restores the bindings we touch, since sfml caches its own
+struct GlBindingGuard
+{
+	GLint texture{}, unpack_buffer{};
+
+	GlBindingGuard()
+	{
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+	}
+
+	~GlBindingGuard()
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		GlBufferFunctions::get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack_buffer);
+	}
+};
+
+} // namespace
+
+namespace tt
+{
+
+VideoFramePool::VideoFramePool(const sf::Vector2u size, const int num_frames)
+	: size{size}
+{
+	if (num_frames < 1)
+		throw std::invalid_argument{"VideoFramePool: num_frames must be positive"};
+
+	textures.reserve(num_frames);
+	for (int i = 0; i < num_frames; ++i)
+		textures.emplace_back(size);
+
+	const ContextGuard context;
+	if (const auto &gl = GlBufferFunctions::get(); gl.loaded())
+	{
+		const GlBindingGuard guard;
+		pbos.resize(num_frames);
+		gl.GenBuffers(num_frames, pbos.data());
+		for (const auto pbo : pbos)
+		{
+			gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+			gl.BufferData(GL_PIXEL_UNPACK_BUFFER, 4 * size.x * size.y, nullptr, GL_STREAM_DRAW);
+		}
+	}
+	else
+		fallback_buffer.resize(4 * size.x * size.y);
+}
+
+VideoFramePool::~VideoFramePool()
+{
+	if (pbos.empty())
+		return;
+	const ContextGuard context;
+	GlBufferFunctions::get().DeleteBuffers(pbos.size(), pbos.data());
+}
+
+bool VideoFramePool::push(const FrameReader &read_frame)
+{
+	const int slot = pushed % textures.size();
+	bool read;
+
+	if (pbos.empty())
+	{
+		if ((read = read_frame(fallback_buffer)))
+			textures[slot].update(fallback_buffer.data());
+	}
+	else
+		push_pbo(slot, read_frame, read);
+
+	if (read)
+		++pushed;
+	return read;
+}
+
+void VideoFramePool::push_pbo(const int slot, const FrameReader &read_frame, bool &read)
+{
+	const auto &gl = GlBufferFunctions::get();
+	const ContextGuard context;
+	const GlBindingGuard guard;
+	const auto bytes = 4 * size.x * size.y;
+
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[slot]);
+
+	// invalidating lets the driver hand out fresh memory instead of waiting for the last upload from this buffer
+	const auto mapped = gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped)
+		throw std::runtime_error{"VideoFramePool: glMapBufferRange failed"};
+
+	try
+	{
+		read = read_frame({static_cast<uint8_t *>(mapped), bytes});
+	}
+	catch (...)
+	{
+		gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		throw;
+	}
+
+	// the buffer contents are undefined if this fails (e.g. the display mode changed); the texture keeps its old frame
+	if (!gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER) || !read)
+		return;
+
+	// with a buffer bound, the "pixels" are an offset into it and this returns without waiting for the copy
+	glBindTexture(GL_TEXTURE_2D, textures[slot].getNativeHandle());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	// make sure the upload is submitted, since the texture is drawn from another context
+	glFlush();
+}
+
+const sf::Texture *VideoFramePool::front() const
+{
+	switch (pushed)
+	{
+	case 0:
+		return nullptr;
+	case 1:
+		return &textures[0];
+	default:
+		return &textures[(pushed - 2) % textures.size()];
+	}
+}
+
+} // namespace tt
@@ -0,0 +1,30 @@
+#include "tt/YuvConverter.hpp"
+
+#include <stdexcept>
+
+namespace tt
+{
+
+YuvConverter::YuvConverter(const sf::Vector2u size, const bool nv12, const bool bt709, const bool full_range)
+	: size{size},
+	  nv12{nv12},
+	  bt709{bt709},
+	  full_range{full_range}
+{
+	if (size.x % 4 || size.y % 2)
+		throw std::invalid_argument{"YuvConverter: width must be divisible by 4, height by 2"};
+}
+
+void YuvConverter::draw(sf::RenderTarget &target, const sf::Texture &texture) const
+{
+	shader.setUniform("frame", texture);
+	shader.setUniform("size", sf::Glsl::Ivec2{(int)size.x, (int)size.y});
+	shader.setUniform("nv12", nv12);
+	shader.setUniform("bt709", bt709);
+	shader.setUniform("full_range", full_range);
+
+	// the shader only looks at fragment coordinates, so any shape covering the target will do
+	target.draw(sf::RectangleShape{sf::Vector2f(size)}, &shader);
+}
+
+} // namespace tt
@@ -11,25 +11,28 @@ SongMetadataDrawable::SongMetadataDrawable(sf::Text &title_text, sf::Text &artis
 
 void SongMetadataDrawable::use_metadata(const Media &media)
 {
-	if (const auto title = media.format().metadata("title"))
-		title_text.setString(title);
-	else if (const auto title = media.astream().metadata("title"))
-		title_text.setString(title);
-
-	if (const auto artist = media.format().metadata("artist"))
-		artist_text.setString(artist);
-	else if (const auto artist = media.astream().metadata("artist"))
-		artist_text.setString(artist);
+	// a playlist's next track mustn't keep the previous one's
+	title_text.setString(media.metadata("title").value_or(""));
+	artist_text.setString(media.metadata("artist").value_or(""));
 }
 
 void SongMetadataDrawable::set_album_cover(const sf::Texture &txr, const sf::Vector2f size)
 {
 	ac_txr = txr;
+	// the previous cover's texture rect may not fit this one
+	ac_spr.setTexture(ac_txr, true);
 	ac_spr.capture_centered_square_view();
 	ac_spr.scale_to(size);
 	update_text_positions();
 }
 
+void SongMetadataDrawable::clear_album_cover()
+{
+	ac_txr = {};
+	ac_spr.setTextureRect({});
+	update_text_positions();
+}
+
 void SongMetadataDrawable::set_position(const sf::Vector2f pos)
 {
 	ac_spr.setPosition(pos);
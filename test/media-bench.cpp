@@ -0,0 +1,139 @@
+#include "media/MediaFactory.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// measures how fast each media backend decodes a file, the way audioviz consumes it:
+// audio in video-frame-sized chunks, and video frames by their timestamps as they become due
+
+using Clock = std::chrono::steady_clock;
+
+// cpu seconds used by this process and its waited-for children (the ffmpeg backends' processes)
+static double cpu_seconds()
+{
+#ifdef _WIN32
+	return NAN;
+#else
+	double total{};
+	for (const auto who : {RUSAGE_SELF, RUSAGE_CHILDREN})
+	{
+		rusage usage;
+		getrusage(who, &usage);
+		total += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	}
+	return total;
+#endif
+}
+
+static double seconds_since(const Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void bench(
+	const std::string &url, const MediaBackend backend, const sf::Vector2u video_size, const bool yuv, const int framerate)
+{
+	const auto cpu_start = cpu_seconds();
+	const auto start = Clock::now();
+
+	double startup{};
+	long samples{}, frames{};
+	{
+		// video faster than the output is thinned out while decoding, as audioviz has it
+		const auto media = create_media(url, video_size, backend, FfmpegCliMedia::PcmFormat::F32LE, framerate, {}, yuv);
+		const auto nb_channels = media->nb_channels();
+		const int afpvf = media->sample_rate() / framerate;
+
+		// time until the first audio is available, including probing and spawning processes
+		media->decode_audio(1);
+		startup = seconds_since(start);
+
+		bool video_eof = !(media->vstream() && video_size.x && video_size.y);
+		std::vector<uint8_t> video_frame(media->video_frame_bytes());
+		// time of the last frame read, which is shown once it's due and then replaced; like `audioviz::advance_video`
+		double next_video_time{};
+
+		for (long audio_frames = 0;;)
+		{
+			media->decode_audio(afpvf);
+			const auto available = std::min(afpvf, media->audio_buffer().frames());
+			if (!available)
+				break;
+			samples += (long)available * nb_channels;
+			media->audio_buffer_erase(available);
+			audio_frames += available;
+
+			// read frames by their timestamps as they become due, within half an output frame
+			const auto now = (double)audio_frames / media->sample_rate();
+			while (!video_eof && next_video_time <= now + 0.5 / framerate)
+			{
+				if ((video_eof = !media->read_video_frame(video_frame)))
+					break;
+				++frames;
+				next_video_time = media->video_frame_time();
+			}
+		}
+	} // destroy the media first, so that its child processes are waited for and counted
+
+	const auto elapsed = seconds_since(start);
+	const auto cpu = cpu_seconds() - cpu_start;
+
+	std::cout << std::left << std::setw(14) << to_string(backend) << std::right << std::fixed << std::setprecision(3)
+			  << std::setw(10) << startup << std::setw(10) << elapsed << std::setw(14) << std::setprecision(0)
+			  << samples / elapsed << std::setw(10) << std::setprecision(1) << frames / elapsed << std::setw(9)
+			  << std::setprecision(0) << 100 * cpu / elapsed << "%\n";
+}
+
+int main(const int argc, const char *const *const argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <media file> [<size.x> <size.y> [yuv]] [backend...]\n"
+				  << "backends: libav, ffmpeg-boost, ffmpeg-popen, wav, auto (default: all)\n"
+				  << "yuv: pipe video as 4:2:0 yuv where the backend can, like --yuv-video\n";
+		return EXIT_FAILURE;
+	}
+
+	const std::string url{argv[1]};
+	int argi = 2;
+
+	// decode video too if a size is given
+	sf::Vector2u video_size;
+	if (argc >= 4 && std::isdigit(*argv[2]))
+	{
+		video_size = {(uint)std::stoi(argv[2]), (uint)std::stoi(argv[3])};
+		argi = 4;
+	}
+
+	const bool yuv = argi < argc && std::string{argv[argi]} == "yuv";
+	if (yuv)
+		++argi;
+
+	std::vector<MediaBackend> backends;
+	for (; argi < argc; ++argi)
+		backends.push_back(media_backend_from_string(argv[argi]));
+	if (backends.empty())
+		backends = {MediaBackend::LIBAV, MediaBackend::FFMPEG_BOOST, MediaBackend::FFMPEG_POPEN, MediaBackend::WAV};
+
+	std::cout << "auto picks: " << to_string(choose_media_backend(url, video_size.x && video_size.y)) << "\n\n";
+	std::cout << std::left << std::setw(14) << "backend" << std::right << std::setw(10) << "startup" << std::setw(10)
+			  << "total" << std::setw(14) << "samples/s" << std::setw(10) << "frames/s" << std::setw(10) << "cpu" << '\n';
+
+	for (const auto backend : backends)
+		try
+		{
+			bench(url, backend, video_size, yuv, 60);
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << std::left << std::setw(14) << to_string(backend) << "failed: " << e.what() << '\n';
+		}
+}
@@ -37,12 +37,12 @@ int main(const int argc, const char *const *const argv)
 
 	std::unique_ptr<Media> media{new FfmpegCliBoostMedia{argv[3]}};
 
-	int afpvf{media->astream().sample_rate() / 60};
+	int afpvf{media->sample_rate() / 60};
 
-	std::vector<float> left_channel(scope.get_shape_count()), spectrum(fft_size);
+	std::vector<float> spectrum(fft_size);
 
 	pa::PortAudio _;
-	pa::Stream pa_stream{0, media->astream().nb_channels(), paFloat32, media->astream().sample_rate()};
+	pa::Stream pa_stream{0, media->nb_channels(), paFloat32 | paNonInterleaved, media->sample_rate()};
 	pa_stream.start();
 
 	const sf::Vector2f _origin{size.x / 2.f, size.y / 2.f};
@@ -66,12 +66,11 @@ int main(const int argc, const char *const *const argv)
 		{
 			media->decode_audio(scope.get_shape_count());
 
-			if (media->audio_buffer().size() < scope.get_shape_count())
+			if (media->audio_buffer().frames() < scope.get_shape_count())
 				break;
 
-			// copy just the left channel
-			for (int i = 0; i < scope.get_shape_count(); ++i)
-				left_channel[i] = media->audio_buffer()[i * media->astream().nb_channels() + 0 /* left channel */];
+			// just the left channel
+			const auto left_channel = media->audio_buffer().channel(0);
 			scope.update_shape_positions(left_channel);
 
 			fa.copy_to_input(left_channel.data());
@@ -81,7 +80,7 @@ int main(const int argc, const char *const *const argv)
 
 			try
 			{
-				pa_stream.write(media->audio_buffer().data(), afpvf);
+				pa_stream.write(media->audio_buffer().channels(), afpvf);
 			}
 			catch (const pa::Error &e)
 			{